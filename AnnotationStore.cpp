@@ -0,0 +1,712 @@
+#include <iostream>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <utility>
+
+#include "AnnotationStore.h"
+#include "LabelParser.h"
+#include "StageProfiler.h"
+
+using namespace std;
+
+// "pack": the container is rewritten once this many frames are dirty or its last rewrite is this old,
+// until then the changed frames only live in memory and in the journal
+static const int PACK_REWRITE_FRAMES = 512;
+static const int PACK_REWRITE_SECONDS = 30;
+
+static bool same_label(const Label &a, const Label &b)
+{
+    return a.class_id == b.class_id && a.cx == b.cx && a.cy == b.cy && a.w == b.w && a.h == b.h;
+}
+
+static vector<Label> subtract(const vector<Label> &labels, const vector<Label> &taken)
+{
+    /*
+    `labels` without `taken`, one occurrence per label of `taken`.
+    */
+
+    vector<Label> result = labels;
+    for (const Label &label : taken)
+    {
+        for (auto it = result.rbegin(); it != result.rend(); ++it)
+        {
+            if (same_label(*it, label))
+            {
+                result.erase(next(it).base());
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+AnnotationStore::AnnotationStore()
+{
+    this->flush_interval_ms = 1000;
+    this->use_pack = false;
+    this->read_only = false;
+    this->outputs = nullptr;
+    this->undo_limit = 0;
+    this->next_action = 0;
+    this->stopping = false;
+}
+
+AnnotationStore::~AnnotationStore()
+{
+    // Unwinding from a failure already reported, a second one only gets printed
+    try
+    {
+        this->close();
+    }
+    catch (const exception &e)
+    {
+        cout << e.what() << endl;
+    }
+}
+
+void AnnotationStore::set_outputs(OutputManifest *outputs)
+{
+    /*
+    Label files are listed from `outputs` and every write or removal is recorded there.
+    Set before `open`, the manifest has to be scanned on the same `out_dir`.
+    */
+
+    this->outputs = outputs;
+
+    return;
+}
+
+void AnnotationStore::set_undo_limit(int undo_limit)
+{
+    /*
+    Keep the last `undo_limit` actions for `undo` / `redo`, 0 (the default) keeps none.
+    */
+
+    this->undo_limit = max(undo_limit, 0);
+
+    return;
+}
+
+void AnnotationStore::set_read_only(bool read_only)
+{
+    /*
+    Read the labels without ever writing to `out_dir`, e.g. to render them. Set before `open`.
+    Edits of a run that did not close cleanly are shown, but stay in its journal.
+    */
+
+    this->read_only = read_only;
+
+    return;
+}
+
+void AnnotationStore::open(filesystem::path out_dir, int flush_interval_ms, string label_format)
+{
+    /*
+    Load the labels of `out_dir` once and start the write-behind thread.
+
+    label_format:
+        "txt"  --> one `NNNNNN.txt` per frame, all of them are parsed here.
+        "pack" --> one `labels.pack` container, mapped in place and read on demand.
+    */
+
+    if (label_format != "txt" && label_format != "pack")
+        throw runtime_error("`label_format` invalid: " + label_format + "\nSupport: \"txt\", \"pack\"");
+
+    this->out_dir = out_dir;
+    this->flush_interval_ms = max(flush_interval_ms, 1);
+    this->use_pack = label_format == "pack";
+    this->pack_path = this->out_dir / "labels.pack";
+
+    this->load();
+
+    if (this->read_only)
+    {
+        lock_guard<mutex> lock(this->mtx);
+        for (LabelEdit &edit : EditJournal::read(this->out_dir / "labels.journal"))
+            this->frames[edit.frame_id] = edit.after;
+        this->dirty.clear();
+        return;
+    }
+
+    // Edits of a run that did not close cleanly, newer than the label files
+    vector<LabelEdit> edits = this->journal.open(this->out_dir / "labels.journal");
+    if (!edits.empty())
+    {
+        lock_guard<mutex> lock(this->mtx);
+        for (LabelEdit &edit : edits)
+        {
+            this->frames[edit.frame_id] = edit.after;
+            this->dirty.insert(edit.frame_id);
+        }
+        cout << "Replayed " << edits.size() << " edits from " << this->out_dir / "labels.journal" << endl;
+    }
+
+    this->stopping = false;
+    this->pack_written = chrono::steady_clock::now();
+    this->flusher = thread(&AnnotationStore::flush_loop, this);
+
+    return;
+}
+
+void AnnotationStore::close()
+{
+    if (this->read_only)
+    {
+        this->pack.close();
+        return;
+    }
+
+    if (!this->flusher.joinable())
+        return;
+
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->stopping = true;
+    }
+    this->cv.notify_all();
+    this->flusher.join();
+    this->rethrow_flush_error();
+
+    this->flush();
+    this->pack.close();
+
+    // Every edit is in the label files, a journal left behind means the run did not finish
+    bool empty = this->journal.size() <= (int64_t)sizeof(EditJournalHeader);
+    this->journal.close();
+    if (empty)
+        filesystem::remove(this->out_dir / "labels.journal");
+
+    this->undo_actions.clear();
+    this->redo_actions.clear();
+
+    return;
+}
+
+bool AnnotationStore::has(int frame_id)
+{
+    lock_guard<mutex> lock(this->mtx);
+
+    auto it = this->frames.find(frame_id);
+    if (it != this->frames.end())
+        return !it->second.empty();
+    return this->pack.count(frame_id) > 0;
+}
+
+vector<Label> AnnotationStore::get(int frame_id)
+{
+    lock_guard<mutex> lock(this->mtx);
+
+    auto it = this->frames.find(frame_id);
+    if (it != this->frames.end())
+        return it->second;
+
+    const Label *labels = this->pack.get(frame_id);
+    return vector<Label>(labels, labels + this->pack.count(frame_id));
+}
+
+vector<int> AnnotationStore::frame_ids()
+{
+    /*
+    Every frame holding labels, in order.
+    */
+
+    lock_guard<mutex> lock(this->mtx);
+
+    std::set<int> ids;
+    for (auto &it : this->frames)
+        if (!it.second.empty())
+            ids.insert(it.first);
+
+    for (int frame_id = 0; frame_id < this->pack.frame_count(); ++frame_id)
+        if (this->pack.count(frame_id) > 0 && this->frames.find(frame_id) == this->frames.end())
+            ids.insert(frame_id);
+
+    return vector<int>(ids.begin(), ids.end());
+}
+
+void AnnotationStore::add(int frame_id, vector<Label> labels, int action)
+{
+    /*
+    Append `labels` to the frame. `action` is the id from `begin_action` the edit belongs to,
+    -1 means the action begun last.
+    */
+
+    lock_guard<mutex> lock(this->mtx);
+    this->rethrow_flush_error();
+
+    vector<Label> &stored = this->fetch(frame_id);
+
+    LabelEdit edit;
+    edit.frame_id = frame_id;
+    edit.before = stored;
+    stored.insert(stored.end(), labels.begin(), labels.end());
+    edit.after = stored;
+
+    this->dirty.insert(frame_id);
+    this->record(edit, action);
+
+    return;
+}
+
+void AnnotationStore::set(int frame_id, vector<Label> labels, int action)
+{
+    lock_guard<mutex> lock(this->mtx);
+    this->rethrow_flush_error();
+
+    LabelEdit edit;
+    edit.frame_id = frame_id;
+    edit.before = this->fetch(frame_id);
+    edit.after = labels;
+
+    this->frames[frame_id] = labels;
+    this->dirty.insert(frame_id);
+    this->record(edit, action);
+
+    return;
+}
+
+int AnnotationStore::begin_action()
+{
+    /*
+    Start a new action and return its id. `undo` reverts a whole action at once
+    (e.g. every box one track wrote), edits of other actions on the same frames are kept.
+    */
+
+    lock_guard<mutex> lock(this->mtx);
+
+    int id = this->next_action++;
+    if (this->undo_limit <= 0)
+        return id;
+
+    this->undo_actions.push_back({id, {}});
+    if ((int)this->undo_actions.size() > this->undo_limit)
+        this->undo_actions.pop_front();
+
+    return id;
+}
+
+int AnnotationStore::undo(int &action)
+{
+    /*
+    Revert the last action that changed labels: its boxes are taken out, the boxes it removed come back.
+    Returns its first frame and sets `action` to its id, -1 when there is nothing to undo.
+    The revert is an edit like any other, journaled so it survives a crash.
+    */
+
+    lock_guard<mutex> lock(this->mtx);
+
+    // Actions that changed nothing yet (e.g. a track not written so far) stay open
+    auto last = this->undo_actions.rbegin();
+    while (last != this->undo_actions.rend() && last->deltas.empty())
+        ++last;
+    if (last == this->undo_actions.rend())
+        return -1;
+
+    LabelAction reverted = move(*last);
+    this->undo_actions.erase(next(last).base());
+
+    for (auto it = reverted.deltas.rbegin(); it != reverted.deltas.rend(); ++it)
+        this->apply_delta(it->frame_id, it->added, it->removed);
+
+    action = reverted.id;
+    this->redo_actions.push_back(move(reverted));
+
+    return this->redo_actions.back().deltas.front().frame_id;
+}
+
+int AnnotationStore::redo(int &action)
+{
+    /*
+    Apply the last undone action again, returns its first frame and sets `action` to its id,
+    -1 when there is nothing to redo.
+    */
+
+    lock_guard<mutex> lock(this->mtx);
+
+    if (this->redo_actions.empty())
+        return -1;
+
+    LabelAction applied = move(this->redo_actions.back());
+    this->redo_actions.pop_back();
+
+    for (LabelDelta &delta : applied.deltas)
+        this->apply_delta(delta.frame_id, delta.removed, delta.added);
+
+    action = applied.id;
+    this->undo_actions.push_back(move(applied));
+    if ((int)this->undo_actions.size() > this->undo_limit)
+        this->undo_actions.pop_front();
+
+    return this->undo_actions.back().deltas.front().frame_id;
+}
+
+void AnnotationStore::flush(bool force)
+{
+    /*
+    Write every dirty frame to its txt file.
+    A frame without labels has its txt file removed, unless the file kept malformed lines.
+    The container of "pack" is only rewritten when `force` is set or past the rewrite thresholds.
+    */
+
+    if (this->read_only || this->dirty_count() == 0)
+        return;
+
+    lock_guard<mutex> write_lock(this->write_mtx);
+    ScopedStage stage(STAGE_LABEL_FLUSH, -1);
+
+    if (this->use_pack)
+    {
+        this->flush_pack(force);
+        return;
+    }
+
+    vector<pair<int, vector<Label>>> pending;
+    int64_t journaled; // Journal bytes covered by the snapshot
+    {
+        lock_guard<mutex> lock(this->mtx);
+        for (int frame_id : this->dirty)
+            pending.push_back({frame_id, this->frames[frame_id]});
+        this->dirty.clear();
+        journaled = this->journal.size();
+    }
+
+    for (auto &it : pending)
+        this->write_frame(it.first, it.second);
+
+    lock_guard<mutex> lock(this->mtx);
+    this->compact(journaled);
+
+    return;
+}
+
+int AnnotationStore::dirty_count()
+{
+    lock_guard<mutex> lock(this->mtx);
+    return this->dirty.size();
+}
+
+void AnnotationStore::load()
+{
+    lock_guard<mutex> lock(this->mtx);
+
+    this->frames.clear();
+    this->dirty.clear();
+    this->malformed.clear();
+
+    if (!this->use_pack)
+    {
+        this->load_txt();
+        return;
+    }
+
+    if (this->pack.open(this->pack_path))
+    {
+        cout << "Mapped label pack of " << this->pack.frame_count() << " frames: " << this->pack_path << endl;
+        return;
+    }
+
+    // First run with "pack", import the existing txt files into the container
+    this->load_txt();
+    for (auto &it : this->frames)
+        this->dirty.insert(it.first);
+
+    return;
+}
+
+void AnnotationStore::load_txt()
+{
+    /*
+    Parse every `NNNNNN.txt` of `out_dir`.
+    Empty (0 byte) files are marked dirty so the first flush removes them,
+    the snapshot already knows their size so they are not even opened.
+    Malformed lines are kept as they are, the file is never rewritten without them.
+    */
+
+    vector<int> frame_ids;
+    if (this->outputs != nullptr)
+        frame_ids = this->outputs->label_ids();
+    else
+    {
+        for (auto &file : filesystem::directory_iterator(this->out_dir))
+        {
+            if (file.path().extension() != ".txt")
+                continue;
+
+            string stem = file.path().stem().string();
+            if (stem.empty() || stem.find_first_not_of("0123456789") != string::npos)
+                continue;
+
+            frame_ids.push_back(stoi(stem));
+        }
+    }
+
+    string buffer;
+    for (int frame_id : frame_ids)
+    {
+        if (this->outputs != nullptr && this->outputs->label_size(frame_id) == 0)
+        {
+            this->frames[frame_id];
+            this->dirty.insert(frame_id);
+            continue;
+        }
+
+        filesystem::path path = this->label_path(frame_id);
+        if (!LabelParser::read_file(path, buffer))
+            throw runtime_error("Fail to open: " + path.string());
+
+        vector<Label> &labels = this->frames[frame_id];
+        LabelParser parser(buffer);
+        Label label;
+        ParseResult result;
+        while ((result = parser.next(label)) != PARSE_END)
+        {
+            if (result == PARSE_LABEL)
+                labels.push_back(label);
+            else
+            {
+                cout << "Keep malformed line " << parser.line_number() << " in " << path << ": " << parser.line() << endl;
+                this->malformed[frame_id].append(parser.line()).append("\n");
+            }
+        }
+
+        if (buffer.empty())
+            this->dirty.insert(frame_id);
+    }
+    cout << "Loaded labels of " << this->frames.size() << " frames" << endl;
+
+    return;
+}
+
+vector<Label> &AnnotationStore::fetch(int frame_id)
+{
+    /*
+    Labels of `frame_id` that can be modified in memory, copied from the pack on first use.
+    Caller holds `mtx`.
+    */
+
+    auto it = this->frames.find(frame_id);
+    if (it != this->frames.end())
+        return it->second;
+
+    const Label *labels = this->pack.get(frame_id);
+    return this->frames[frame_id] = vector<Label>(labels, labels + this->pack.count(frame_id));
+}
+
+void AnnotationStore::record(LabelEdit &edit, int action)
+{
+    /*
+    Journal `edit` and keep what it changed in `action` for `undo`. Caller holds `mtx`.
+    */
+
+    if (this->journal.is_open())
+        this->journal.append(edit);
+
+    if (this->undo_limit <= 0)
+        return;
+
+    LabelAction *target = nullptr;
+    if (action < 0)
+    {
+        if (this->undo_actions.empty())
+            this->undo_actions.push_back({this->next_action++, {}});
+        target = &this->undo_actions.back();
+    }
+    else
+    {
+        // An action pushed out of the history is not recorded any more
+        for (auto it = this->undo_actions.rbegin(); it != this->undo_actions.rend() && target == nullptr; ++it)
+            if (it->id == action)
+                target = &*it;
+        if (target == nullptr)
+            return;
+    }
+
+    LabelDelta delta;
+    delta.frame_id = edit.frame_id;
+    delta.added = subtract(edit.after, edit.before);
+    delta.removed = subtract(edit.before, edit.after);
+    if (delta.added.empty() && delta.removed.empty())
+        return;
+
+    target->deltas.push_back(move(delta));
+    this->redo_actions.clear();
+
+    return;
+}
+
+void AnnotationStore::apply_delta(int frame_id, const vector<Label> &remove, const vector<Label> &add)
+{
+    /*
+    Take `remove` out of the frame and append `add`, the other labels of the frame stay. Caller holds `mtx`.
+    */
+
+    vector<Label> &stored = this->fetch(frame_id);
+
+    LabelEdit edit;
+    edit.frame_id = frame_id;
+    edit.before = stored;
+    stored = subtract(stored, remove);
+    stored.insert(stored.end(), add.begin(), add.end());
+    edit.after = stored;
+
+    this->dirty.insert(frame_id);
+    if (this->journal.is_open())
+        this->journal.append(edit);
+
+    return;
+}
+
+void AnnotationStore::compact(int64_t journaled)
+{
+    /*
+    The label files hold every edit of the first `journaled` bytes of the journal: drop those records.
+    Edits that came in while writing stay, so the journal shrinks even when edits never stop.
+    Caller holds `mtx`.
+    */
+
+    if (this->journal.is_open() && journaled > (int64_t)sizeof(EditJournalHeader))
+        this->journal.drop_before(journaled);
+
+    return;
+}
+
+void AnnotationStore::flush_loop()
+{
+    /*
+    A failed write stops the thread, the error is thrown again on the owner thread
+    by the next `add`, `set` or `close`. The dirty frames stay in the journal.
+    */
+
+    unique_lock<mutex> lock(this->mtx);
+
+    while (!this->stopping)
+    {
+        this->cv.wait_for(lock, chrono::milliseconds(this->flush_interval_ms), [this]()
+                          { return this->stopping; });
+
+        if (this->stopping)
+            break;
+
+        lock.unlock();
+        try
+        {
+            this->flush(false);
+        }
+        catch (...)
+        {
+            lock.lock();
+            this->flush_error = current_exception();
+            break;
+        }
+        lock.lock();
+    }
+
+    return;
+}
+
+void AnnotationStore::rethrow_flush_error()
+{
+    /*
+    Caller holds `mtx` or the thread is joined.
+    */
+
+    if (this->flush_error)
+        rethrow_exception(exchange(this->flush_error, nullptr));
+
+    return;
+}
+
+void AnnotationStore::flush_pack(bool force)
+{
+    /*
+    Rewrite the container with the dirty frames and map the new one.
+    Every rewrite copies all boxes of the video, so the periodic flush batches edits
+    until `PACK_REWRITE_FRAMES` frames are dirty or `PACK_REWRITE_SECONDS` have passed,
+    the journal keeps them safe meanwhile. `close` always rewrites.
+    Caller holds `write_mtx`, readers keep using the old mapping while it is written.
+    */
+
+    unordered_map<int, vector<Label>> pending;
+    int64_t journaled; // Journal bytes covered by the snapshot
+    {
+        lock_guard<mutex> lock(this->mtx);
+        if (this->dirty.empty())
+            return;
+
+        auto age = chrono::steady_clock::now() - this->pack_written;
+        if (!force && (int)this->dirty.size() < PACK_REWRITE_FRAMES && age < chrono::seconds(PACK_REWRITE_SECONDS))
+            return;
+
+        for (int frame_id : this->dirty)
+            pending[frame_id] = this->frames[frame_id];
+        this->dirty.clear();
+        journaled = this->journal.size();
+    }
+
+    LabelPack::write(this->pack_path, this->pack, pending);
+
+    lock_guard<mutex> lock(this->mtx);
+    this->pack.open(this->pack_path);
+    this->pack_written = chrono::steady_clock::now();
+
+    // Frames changed again while writing stay in memory for the next flush
+    for (auto &it : pending)
+    {
+        if (this->dirty.find(it.first) == this->dirty.end())
+            this->frames.erase(it.first);
+    }
+    this->compact(journaled);
+
+    return;
+}
+
+void AnnotationStore::write_frame(int frame_id, const vector<Label> &labels)
+{
+    filesystem::path save_txt_path = this->label_path(frame_id);
+
+    // Only filled by `load`, before the flush thread starts
+    auto kept = this->malformed.find(frame_id);
+    bool has_malformed = kept != this->malformed.end();
+
+    if (labels.empty() && !has_malformed)
+    {
+        // Nothing to remove when the manifest never saw the file
+        if (this->outputs != nullptr && !this->outputs->has_label(frame_id))
+            return;
+
+        filesystem::remove(save_txt_path);
+        if (this->outputs != nullptr)
+            this->outputs->remove_label(frame_id);
+        return;
+    }
+
+    ofstream ofs(save_txt_path, ios::out | ios::binary | ios::trunc);
+    if (!ofs.is_open())
+        throw runtime_error("Fail to open: " + save_txt_path.string());
+
+    // The whole file is formatted in one buffer and written at once
+    string text(labels.size() * LABEL_LINE_MAX, '\0');
+    char *end = text.data();
+    for (const Label &label : labels)
+        end = LabelParser::format(end, label);
+    ofs.write(text.data(), end - text.data());
+    if (has_malformed)
+        ofs.write(kept->second.data(), kept->second.size());
+    ofs.close();
+
+    if (this->outputs != nullptr)
+        this->outputs->set_label(frame_id, end - text.data() + (has_malformed ? kept->second.size() : 0));
+
+    return;
+}
+
+filesystem::path AnnotationStore::label_path(int frame_id)
+{
+    stringstream ss;
+    ss << setw(6) << setfill('0') << frame_id;
+
+    return this->out_dir / (ss.str() + ".txt");
+}
@@ -0,0 +1,104 @@
+#ifndef __AnnotationStore__H
+#define __AnnotationStore__H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+
+#include "LabelPack.h"
+#include "OutputManifest.h"
+#include "EditJournal.h"
+
+// Labels one action added to and removed from one frame, what `undo` takes back
+struct LabelDelta
+{
+    int frame_id;
+    std::vector<Label> added;
+    std::vector<Label> removed;
+};
+
+struct LabelAction
+{
+    int id;
+    std::vector<LabelDelta> deltas; // In the order of the edits
+};
+
+class AnnotationStore
+{
+public:
+    AnnotationStore();
+    ~AnnotationStore();
+
+    void set_outputs(OutputManifest *outputs);
+    void set_undo_limit(int undo_limit);
+    void set_read_only(bool read_only);
+    void open(std::filesystem::path out_dir, int flush_interval_ms, std::string label_format);
+    void close();
+
+    bool has(int frame_id);
+    std::vector<int> frame_ids();
+    std::vector<Label> get(int frame_id);
+    void add(int frame_id, std::vector<Label> labels, int action = -1);
+    void set(int frame_id, std::vector<Label> labels, int action = -1);
+
+    int begin_action();
+    int undo(int &action);
+    int redo(int &action);
+
+    void flush(bool force = true);
+    int dirty_count();
+
+private:
+    void load();
+    void load_txt();
+    std::vector<Label> &fetch(int frame_id);
+    void record(LabelEdit &edit, int action);
+    void apply_delta(int frame_id, const std::vector<Label> &remove, const std::vector<Label> &add);
+    void compact(int64_t journaled);
+    void flush_loop();
+    void rethrow_flush_error();
+    void flush_pack(bool force);
+    void write_frame(int frame_id, const std::vector<Label> &labels);
+    std::filesystem::path label_path(int frame_id);
+
+private:
+    std::filesystem::path out_dir;
+    int flush_interval_ms;
+    bool use_pack;
+    bool read_only; // Labels are only read: no journal, no flush, nothing in `out_dir` changes
+    OutputManifest *outputs; // Snapshot of `out_dir`, nullptr --> ask the filesystem
+
+    // "txt": every labeled frame, "pack": frames changed since the container was written
+    std::unordered_map<int, std::vector<Label>> frames;
+    LabelPack pack;
+    std::filesystem::path pack_path;
+    std::chrono::steady_clock::time_point pack_written; // Last rewrite of the container
+    std::set<int> dirty;
+    std::unordered_map<int, std::string> malformed; // Lines of a txt file that do not parse, written back as they were
+
+    // Every edit is appended here before it reaches the label files, emptied once they are written
+    EditJournal journal;
+
+    // Edits grouped by user action, in memory for this session only
+    int undo_limit; // Actions kept, 0 means no history
+    int next_action;
+    std::deque<LabelAction> undo_actions; // Oldest first
+    std::vector<LabelAction> redo_actions;
+
+    std::thread flusher;
+    std::mutex mtx;
+    std::mutex write_mtx;
+    std::condition_variable cv;
+    bool stopping;
+    std::exception_ptr flush_error; // Failure of the write-behind thread, thrown again by the owner
+};
+
+#endif
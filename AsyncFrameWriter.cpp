@@ -0,0 +1,142 @@
+#include <iostream>
+
+#include "AsyncFrameWriter.h"
+#include "StageProfiler.h"
+
+using namespace cv;
+using namespace std;
+
+AsyncFrameWriter::AsyncFrameWriter(int queue_depth, int num_threads)
+{
+    /*
+    `num_threads <= 0` means one writer per hardware thread.
+    */
+
+    if (num_threads <= 0)
+        num_threads = max((int)thread::hardware_concurrency(), 1);
+
+    this->queue_depth = max(queue_depth, 1);
+    this->in_flight = 0;
+    this->failed = 0;
+    this->limit = nullptr;
+    this->stopping = false;
+
+    for (int i = 0; i < num_threads; ++i)
+        this->writers.emplace_back(&AsyncFrameWriter::writer_loop, this);
+}
+
+AsyncFrameWriter::~AsyncFrameWriter()
+{
+    this->flush();
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->stopping = true;
+    }
+    this->cv.notify_all();
+
+    for (auto &writer : this->writers)
+        writer.join();
+}
+
+void AsyncFrameWriter::set_limit(Semaphore *limit)
+{
+    /*
+    At most the count of `limit` frames are encoded at once across every writer sharing it.
+    */
+
+    this->limit = limit;
+}
+
+void AsyncFrameWriter::set_params(vector<int> params)
+{
+    /*
+    `imwrite` parameters of every frame, e.g. {IMWRITE_JPEG_QUALITY, 95}. Set before the first write.
+    */
+
+    this->params = params;
+}
+
+void AsyncFrameWriter::write(filesystem::path save_img_path, Mat frame)
+{
+    /*
+    Queue `frame` to be encoded to `save_img_path`.
+    Blocks while the queue is full, so a slow disk slows the caller down instead of growing memory.
+    The caller must not draw on `frame` afterwards.
+    */
+
+    {
+        unique_lock<mutex> lock(this->mtx);
+        this->cv.wait(lock, [this]()
+                      { return (int)this->jobs.size() < this->queue_depth; });
+
+        this->jobs.push({save_img_path, frame});
+    }
+    this->cv.notify_all();
+
+    return;
+}
+
+int AsyncFrameWriter::flush()
+{
+    /*
+    Block until every queued frame is written.
+    Returns the number of frames that failed to write since the writer started, 0 when all are on disk.
+    */
+
+    unique_lock<mutex> lock(this->mtx);
+    this->cv.wait(lock, [this]()
+                  { return this->jobs.empty() && this->in_flight == 0; });
+
+    return this->failed;
+}
+
+int AsyncFrameWriter::pending()
+{
+    lock_guard<mutex> lock(this->mtx);
+    return this->jobs.size() + this->in_flight;
+}
+
+void AsyncFrameWriter::writer_loop()
+{
+    while (true)
+    {
+        WriteJob job;
+        {
+            unique_lock<mutex> lock(this->mtx);
+            this->cv.wait(lock, [this]()
+                          { return this->stopping || !this->jobs.empty(); });
+
+            if (this->stopping && this->jobs.empty())
+                return;
+
+            job = move(this->jobs.front());
+            this->jobs.pop();
+            ++this->in_flight;
+        }
+        this->cv.notify_all();
+
+        bool written = false;
+        {
+            SemaphoreGuard guard(this->limit);
+            ScopedStage stage(STAGE_IMWRITE, -1);
+            try
+            {
+                written = imwrite(job.save_img_path, job.frame, this->params);
+            }
+            catch (const cv::Exception &e)
+            {
+                cout << e.what() << endl;
+            }
+            if (!written)
+                cout << "Fail to write: " << job.save_img_path << endl;
+        }
+
+        {
+            lock_guard<mutex> lock(this->mtx);
+            --this->in_flight;
+            if (!written)
+                ++this->failed;
+        }
+        this->cv.notify_all();
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef __AsyncFrameWriter__H
+#define __AsyncFrameWriter__H
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+
+#include <opencv2/opencv.hpp>
+
+#include "Semaphore.h"
+
+class AsyncFrameWriter
+{
+public:
+    AsyncFrameWriter(int queue_depth, int num_threads);
+    ~AsyncFrameWriter();
+
+    void set_limit(Semaphore *limit);
+    void set_params(std::vector<int> params);
+    void write(std::filesystem::path save_img_path, cv::Mat frame);
+    int flush();
+    int pending();
+
+private:
+    void writer_loop();
+
+private:
+    struct WriteJob
+    {
+        std::filesystem::path save_img_path;
+        cv::Mat frame;
+    };
+
+    std::queue<WriteJob> jobs;
+    int queue_depth;
+    int in_flight;
+    int failed; // Frames `imwrite` could not write, never reset
+    Semaphore *limit; // Shared by every writer of a batch, null when alone
+    std::vector<int> params;
+
+    std::vector<std::thread> writers;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include <yaml-cpp/yaml.h>
+#include <glob.h>
+
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <set>
+
+#include "BatchRunner.h"
+#include "SemiAutomaticLabelingTool.h"
+#include "ThreadPool.h"
+#include "Semaphore.h"
+#include "StageProfiler.h"
+
+using namespace std;
+
+BatchRunner::BatchRunner(string cfg_file)
+{
+    YAML::Node config = YAML::LoadFile(cfg_file);
+
+    this->cfg_file = cfg_file;
+
+    this->videos = config["BATCH"]["videos"].as<vector<string>>();
+    this->task = config["BATCH"]["task"].as<string>();
+    this->jobs = config["BATCH"]["jobs"].as<int>();
+    this->max_decoders = config["BATCH"]["max_decoders"].as<int>();
+    this->max_writers = config["BATCH"]["max_writers"].as<int>();
+
+    this->profile = config["PROFILE"]["enable"].as<bool>();
+    this->trace_path = filesystem::path(config["PROFILE"]["trace_path"].as<string>());
+}
+
+BatchRunner::~BatchRunner()
+{
+}
+
+vector<filesystem::path> BatchRunner::expand(vector<string> patterns)
+{
+    /*
+    Videos matching `patterns` (plain paths or shell globs), sorted, each one once.
+    */
+
+    set<filesystem::path> found;
+
+    for (string &pattern : patterns)
+    {
+        glob_t matches;
+        if (glob(pattern.c_str(), 0, nullptr, &matches) == 0)
+        {
+            for (size_t i = 0; i < matches.gl_pathc; ++i)
+                if (filesystem::is_regular_file(matches.gl_pathv[i]))
+                    found.insert(filesystem::path(matches.gl_pathv[i]));
+        }
+        else
+            cout << "No video matches: " << pattern << endl;
+        globfree(&matches);
+    }
+
+    return vector<filesystem::path>(found.begin(), found.end());
+}
+
+void BatchRunner::run(vector<string> patterns)
+{
+    /*
+    Every video is one job of the pool, `jobs` videos run at once.
+    The decoders and writers of all jobs share `max_decoders` and `max_writers`,
+    so adding jobs does not oversubscribe the disk or the CPU.
+    */
+
+    vector<filesystem::path> video_paths = this->expand(patterns.empty() ? this->videos : patterns);
+    if (video_paths.empty())
+    {
+        cout << "No video to process" << endl
+             << "Set `videos` in `BATCH` or pass them: SemiAutomaticLabelingTool batch ./Videos/*.mp4" << endl;
+        exit(1);
+    }
+
+    ThreadPool pool(this->jobs);
+    int decoders = (this->max_decoders > 0) ? this->max_decoders : pool.size();
+    int writers = (this->max_writers > 0) ? this->max_writers : max((int)thread::hardware_concurrency(), 1);
+    Semaphore decode_limit(decoders);
+    Semaphore write_limit(writers);
+
+    cout << "Batch " << this->task << " of " << video_paths.size() << " videos, "
+         << pool.size() << " jobs, " << decoders << " decoders, " << writers << " writers" << endl;
+
+    StageProfiler::instance().open(this->profile, this->trace_path);
+    auto start_time = chrono::steady_clock::now();
+
+    // A failed video is logged and counted, the other jobs go on
+    atomic<int> done(0);
+    atomic<int> failed(0);
+    vector<future<void>> results;
+    for (filesystem::path &video_path : video_paths)
+    {
+        results.push_back(pool.submit([&, video_path]()
+                                      {
+                                          try
+                                          {
+                                              SemiAutomaticLabel tool(this->cfg_file);
+                                              tool.run_job(video_path, this->task, &decode_limit, &write_limit);
+                                              cout << "[" << ++done << "/" << video_paths.size() << "] Done: " << video_path << endl;
+                                          }
+                                          catch (const exception &e)
+                                          {
+                                              ++failed;
+                                              cout << "[" << ++done << "/" << video_paths.size() << "] Failed: " << video_path << endl
+                                                   << e.what() << endl;
+                                          }
+                                      }));
+    }
+    for (auto &result : results)
+        result.get();
+
+    float seconds = chrono::duration<float>(chrono::steady_clock::now() - start_time).count();
+    cout << "Batch done: " << video_paths.size() - failed << " videos in " << seconds << " s" << endl;
+    if (failed > 0)
+        cout << "Failed: " << failed << " videos" << endl;
+
+    StageProfiler::instance().dump();
+    StageProfiler::instance().close();
+
+    if (failed > 0)
+        exit(1);
+
+    return;
+}
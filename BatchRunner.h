@@ -0,0 +1,32 @@
+#ifndef __BatchRunner__H
+#define __BatchRunner__H
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+class BatchRunner
+{
+public:
+    BatchRunner(std::string cfg_file);
+    ~BatchRunner();
+
+    void run(std::vector<std::string> patterns);
+
+private:
+    std::vector<std::filesystem::path> expand(std::vector<std::string> patterns);
+
+private:
+    std::string cfg_file;
+
+    std::vector<std::string> videos;
+    std::string task;
+    int jobs;
+    int max_decoders;
+    int max_writers;
+
+    bool profile;
+    std::filesystem::path trace_path;
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "BoxGeometry.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+int box_area(const Box &box)
+{
+    int w = max(box.xmax - box.xmin, 0);
+    int h = max(box.ymax - box.ymin, 0);
+
+    return w * h;
+}
+
+int box_overlap(const Box &box1, const Box &box2)
+{
+    Box box({max(box1.xmin, box2.xmin), max(box1.ymin, box2.ymin), min(box1.xmax, box2.xmax), min(box1.ymax, box2.ymax)});
+
+    return box_area(box);
+}
+
+float box_iou(const Box &box1, const Box &box2)
+{
+    int overlap = box_overlap(box1, box2);
+    int union_ = box_area(box1) + box_area(box2) - overlap;
+
+    return (float)overlap / (float)union_;
+}
+
+Box box_clip(const Box &box, int w, int h)
+{
+    return Box({min(max(box.xmin, 0), w - 1),
+                min(max(box.ymin, 0), h - 1),
+                min(max(box.xmax, 0), w - 1),
+                min(max(box.ymax, 0), h - 1)});
+}
+
+BoxBatch::BoxBatch()
+{
+}
+
+BoxBatch::~BoxBatch()
+{
+}
+
+void BoxBatch::clear()
+{
+    this->xmin.clear();
+    this->ymin.clear();
+    this->xmax.clear();
+    this->ymax.clear();
+    this->area.clear();
+}
+
+void BoxBatch::reserve(int n)
+{
+    this->xmin.reserve(n);
+    this->ymin.reserve(n);
+    this->xmax.reserve(n);
+    this->ymax.reserve(n);
+    this->area.reserve(n);
+}
+
+void BoxBatch::push_back(const Box &box)
+{
+    this->xmin.push_back(box.xmin);
+    this->ymin.push_back(box.ymin);
+    this->xmax.push_back(box.xmax);
+    this->ymax.push_back(box.ymax);
+    this->area.push_back(box_area(box));
+}
+
+int BoxBatch::size() const
+{
+    return this->xmin.size();
+}
+
+Box BoxBatch::get(int i) const
+{
+    return Box({(int)this->xmin[i], (int)this->ymin[i], (int)this->xmax[i], (int)this->ymax[i]});
+}
+
+void BoxBatch::overlap(const Box &query, float *out) const
+{
+    /*
+    Overlap area of `query` with every box, `out` holds `size()` values.
+    Pixel coordinates and areas are exact in float up to 16M pixels per box.
+    */
+
+    int n = this->size();
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128 qxmin = _mm_set1_ps((float)query.xmin);
+    __m128 qymin = _mm_set1_ps((float)query.ymin);
+    __m128 qxmax = _mm_set1_ps((float)query.xmax);
+    __m128 qymax = _mm_set1_ps((float)query.ymax);
+    __m128 zero = _mm_setzero_ps();
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 w = _mm_sub_ps(_mm_min_ps(_mm_loadu_ps(&this->xmax[i]), qxmax), _mm_max_ps(_mm_loadu_ps(&this->xmin[i]), qxmin));
+        __m128 h = _mm_sub_ps(_mm_min_ps(_mm_loadu_ps(&this->ymax[i]), qymax), _mm_max_ps(_mm_loadu_ps(&this->ymin[i]), qymin));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_max_ps(w, zero), _mm_max_ps(h, zero)));
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        float w = min(this->xmax[i], (float)query.xmax) - max(this->xmin[i], (float)query.xmin);
+        float h = min(this->ymax[i], (float)query.ymax) - max(this->ymin[i], (float)query.ymin);
+        out[i] = max(w, 0.0f) * max(h, 0.0f);
+    }
+
+    return;
+}
+
+void BoxBatch::iou(const Box &query, float *out) const
+{
+    /*
+    IoU of `query` with every box, same definition as `box_iou`.
+    */
+
+    this->overlap(query, out);
+
+    int n = this->size();
+    int i = 0;
+    float query_area = box_area(query);
+
+#if defined(__SSE2__)
+    __m128 qarea = _mm_set1_ps(query_area);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 overlap = _mm_loadu_ps(out + i);
+        __m128 union_ = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&this->area[i]), qarea), overlap);
+        _mm_storeu_ps(out + i, _mm_div_ps(overlap, union_));
+    }
+#endif
+
+    for (; i < n; ++i)
+        out[i] = out[i] / (this->area[i] + query_area - out[i]);
+
+    return;
+}
+
+BoxGrid::BoxGrid(int width, int height, int cell_size)
+{
+    this->cell_size = max(cell_size, 1);
+    this->cols = max((width + this->cell_size - 1) / this->cell_size, 1);
+    this->rows = max((height + this->cell_size - 1) / this->cell_size, 1);
+    this->cells.resize(this->cols * this->rows);
+    this->stamp = 0;
+}
+
+BoxGrid::~BoxGrid()
+{
+}
+
+int BoxGrid::cell_range(int v, int cells)
+{
+    return min(max(v / this->cell_size, 0), cells - 1);
+}
+
+void BoxGrid::build(const BoxBatch &boxes)
+{
+    /*
+    Register every box in each cell it covers.
+    */
+
+    for (auto &cell : this->cells)
+        cell.clear();
+
+    int n = boxes.size();
+    this->seen.assign(n, 0);
+    this->stamp = 0;
+
+    for (int i = 0; i < n; ++i)
+    {
+        Box box = boxes.get(i);
+        for (int y = this->cell_range(box.ymin, this->rows); y <= this->cell_range(box.ymax, this->rows); ++y)
+            for (int x = this->cell_range(box.xmin, this->cols); x <= this->cell_range(box.xmax, this->cols); ++x)
+                this->cells[y * this->cols + x].push_back(i);
+    }
+
+    return;
+}
+
+void BoxGrid::query(const Box &box, vector<int> &ids)
+{
+    /*
+    Boxes sharing a cell with `box`: every box that can overlap it, plus a few that only come close.
+    */
+
+    ids.clear();
+    ++this->stamp;
+
+    for (int y = this->cell_range(box.ymin, this->rows); y <= this->cell_range(box.ymax, this->rows); ++y)
+        for (int x = this->cell_range(box.xmin, this->cols); x <= this->cell_range(box.xmax, this->cols); ++x)
+            for (int i : this->cells[y * this->cols + x])
+            {
+                if (this->seen[i] == this->stamp)
+                    continue;
+                this->seen[i] = this->stamp;
+                ids.push_back(i);
+            }
+
+    return;
+}
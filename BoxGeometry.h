@@ -0,0 +1,66 @@
+#ifndef __BoxGeometry__H
+#define __BoxGeometry__H
+
+#include <vector>
+
+// [xmin, ymin, xmax, ymax] in pixels
+struct Box
+{
+    int xmin;
+    int ymin;
+    int xmax;
+    int ymax;
+};
+
+int box_area(const Box &box);
+int box_overlap(const Box &box1, const Box &box2);
+float box_iou(const Box &box1, const Box &box2);
+Box box_clip(const Box &box, int w, int h);
+
+class BoxBatch
+{
+public:
+    BoxBatch();
+    ~BoxBatch();
+
+    void clear();
+    void reserve(int n);
+    void push_back(const Box &box);
+    int size() const;
+    Box get(int i) const;
+
+    void overlap(const Box &query, float *out) const;
+    void iou(const Box &query, float *out) const;
+
+private:
+    // Structure of arrays, the kernel tests 4 boxes per step
+    std::vector<float> xmin;
+    std::vector<float> ymin;
+    std::vector<float> xmax;
+    std::vector<float> ymax;
+    std::vector<float> area;
+};
+
+class BoxGrid
+{
+public:
+    BoxGrid(int width, int height, int cell_size);
+    ~BoxGrid();
+
+    void build(const BoxBatch &boxes);
+    void query(const Box &box, std::vector<int> &ids);
+
+private:
+    int cell_range(int v, int cells);
+
+private:
+    int cell_size;
+    int cols;
+    int rows;
+
+    std::vector<std::vector<int>> cells;
+    std::vector<int> seen; // Query stamp per box, a box spanning several cells is reported once
+    int stamp;
+};
+
+#endif
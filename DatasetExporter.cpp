@@ -0,0 +1,430 @@
+#include <yaml-cpp/yaml.h>
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+
+#include "DatasetExporter.h"
+#include "LabelParser.h"
+#include "ImageHeader.h"
+
+using namespace std;
+
+DatasetExporter::DatasetExporter(string cfg_file)
+{
+    YAML::Node config = YAML::LoadFile(cfg_file);
+
+    this->output_dir = filesystem::path(config["PATH"]["OUTPUT_DIR"].as<string>());
+    this->labels_file = filesystem::path(config["PATH"]["labels_file"].as<string>());
+
+    this->coco_path = filesystem::path(config["EXPORT"]["coco_path"].as<string>());
+    this->voc_dir = filesystem::path(config["EXPORT"]["voc_dir"].as<string>());
+    this->labeled_only = config["EXPORT"]["labeled_only"].as<bool>();
+    this->num_threads = config["EXPORT"]["num_threads"].as<int>();
+    this->chunk_frames = max(config["EXPORT"]["chunk_frames"].as<int>(), 1);
+
+    this->image_count = 0;
+    this->annotation_count = 0;
+    this->skipped = 0;
+    this->dropped_boxes = 0;
+}
+
+DatasetExporter::~DatasetExporter()
+{
+}
+
+void DatasetExporter::run(vector<string> args)
+{
+    /*
+    Stream every frame under `OUTPUT_DIR` (or `args[0]`) with its labels to COCO JSON, and to Pascal VOC XML.
+
+    The folder is walked once and frames are handled `chunk_frames` at a time: the chunk is read on the
+    pool (image size from the file header, labels from the txt file or `labels.pack`), then written in order.
+    Nothing but the current chunk is kept, memory does not grow with the number of frames.
+    */
+
+    if (!args.empty())
+        this->output_dir = filesystem::path(args[0]);
+
+    if (!filesystem::is_directory(this->output_dir))
+    {
+        cout << "`OUTPUT_DIR` Not exists: " << this->output_dir << endl;
+        exit(1);
+    }
+
+    if (this->coco_path.empty() && this->voc_dir.empty())
+    {
+        cout << "Nothing to export, set `coco_path` and / or `voc_dir`" << endl;
+        exit(1);
+    }
+
+    this->names = this->read_names(this->labels_file);
+
+    filesystem::path annotations_path = this->coco_path.string() + ".annotations";
+    if (!this->coco_path.empty())
+    {
+        if (this->coco_path.has_parent_path())
+            filesystem::create_directories(this->coco_path.parent_path());
+
+        this->coco.open(this->coco_path, ios::out | ios::binary | ios::trunc);
+        this->annotations.open(annotations_path, ios::out | ios::binary | ios::trunc);
+        if (!this->coco.is_open() || !this->annotations.is_open())
+        {
+            cout << "Fail to open: " << this->coco_path << endl;
+            exit(1);
+        }
+        this->coco << "{\n\"info\": {\"description\": \"Semi-Automatic-LabelingTool export\"},\n\"images\": [";
+    }
+
+    cout << "Export " << this->output_dir << endl;
+
+    ThreadPool pool(this->num_threads);
+    vector<ExportItem> chunk;
+    chunk.reserve(this->chunk_frames);
+
+    for (auto &file : filesystem::recursive_directory_iterator(this->output_dir))
+    {
+        if (!file.is_regular_file())
+            continue;
+
+        filesystem::path path = file.path();
+        string ext = path.extension().string();
+        transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext != ".jpg" && ext != ".jpeg" && ext != ".png" && ext != ".webp")
+            continue;
+
+        string stem = path.stem().string();
+        if (stem.empty() || stem.size() > 9 || stem.find_first_not_of("0123456789") != string::npos)
+            continue;
+
+        ExportItem item;
+        item.folder = this->folder(path.parent_path());
+        item.frame_id = stoi(stem);
+        item.image_path = path;
+        chunk.push_back(move(item));
+
+        if ((int)chunk.size() >= this->chunk_frames)
+        {
+            this->export_chunk(chunk, pool);
+            chunk.clear();
+        }
+    }
+    this->export_chunk(chunk, pool);
+
+    if (!this->coco_path.empty())
+    {
+        this->finish_coco();
+        filesystem::remove(annotations_path);
+    }
+
+    cout << "Exported " << this->image_count << " images, " << this->annotation_count << " boxes, "
+         << this->names.size() << " classes" << endl;
+    if (this->skipped > 0)
+        cout << "Skipped " << this->skipped << " images with an unreadable header" << endl;
+    if (this->dropped_boxes > 0)
+        cout << "Dropped " << this->dropped_boxes << " boxes with a class missing from the names file" << endl;
+    if (!this->coco_path.empty())
+        cout << "COCO: " << this->coco_path << endl;
+    if (!this->voc_dir.empty())
+        cout << "VOC: " << this->voc_dir << endl;
+
+    return;
+}
+
+int DatasetExporter::folder(filesystem::path dir)
+{
+    /*
+    Folder of a video, set up the first time one of its frames is seen:
+    classes from the `.names` file copied next to the labels (`labels_file` when there is none),
+    labels from `labels.pack` when it exists, from the txt files otherwise.
+    */
+
+    auto it = this->folder_of_dir.find(dir);
+    if (it != this->folder_of_dir.end())
+        return it->second;
+
+    ExportFolder folder;
+    folder.dir = dir;
+    folder.relative = filesystem::relative(dir, this->output_dir);
+
+    filesystem::path names_path = dir / (dir.filename().string() + ".names");
+    vector<string> folder_names = filesystem::exists(names_path) ? this->read_names(names_path) : this->read_names(this->labels_file);
+    for (string &class_name : folder_names)
+        folder.class_map.push_back(this->class_index(class_name));
+
+    if (filesystem::exists(dir / "labels.pack"))
+    {
+        folder.pack = make_unique<LabelPack>();
+        if (!folder.pack->open(dir / "labels.pack"))
+        {
+            cout << "Fail to open: " << dir / "labels.pack" << endl;
+            exit(1);
+        }
+    }
+
+    if (!this->voc_dir.empty())
+        filesystem::create_directories(this->voc_dir / folder.relative);
+
+    this->folders.push_back(move(folder));
+    return this->folder_of_dir[dir] = this->folders.size() - 1;
+}
+
+vector<string> DatasetExporter::read_names(filesystem::path names_path)
+{
+    ifstream ifs(names_path, ios::in);
+    if (!ifs.is_open())
+    {
+        cout << "Fail to open: " << names_path << endl;
+        exit(1);
+    }
+
+    vector<string> result;
+    string line;
+    while (getline(ifs, line))
+    {
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line != "")
+            result.push_back(line);
+    }
+
+    return result;
+}
+
+int DatasetExporter::class_index(string class_name)
+{
+    auto it = find(this->names.begin(), this->names.end(), class_name);
+    if (it != this->names.end())
+        return it - this->names.begin();
+
+    this->names.push_back(class_name);
+    return this->names.size() - 1;
+}
+
+void DatasetExporter::export_chunk(vector<ExportItem> &chunk, ThreadPool &pool)
+{
+    /*
+    Read the chunk in parallel, one contiguous range and one read buffer per worker,
+    then write it on this thread so ids follow the order of the walk.
+    */
+
+    int n = chunk.size();
+    int workers = min(n, pool.size());
+    pool.parallel_for(workers, [&](int worker)
+                      {
+                          string buffer;
+                          for (int i = worker * n / workers; i < (worker + 1) * n / workers; ++i)
+                          {
+                              this->read_item(chunk[i], buffer);
+                              if (!this->voc_dir.empty() && chunk[i].readable && !(this->labeled_only && chunk[i].labels.empty()))
+                                  this->write_voc(chunk[i]);
+                          }
+                      });
+
+    for (ExportItem &item : chunk)
+    {
+        if (!item.readable)
+        {
+            if (this->skipped++ < 10)
+                cout << "Unreadable image header: " << item.image_path << endl;
+            continue;
+        }
+        this->dropped_boxes += item.dropped;
+        if (this->labeled_only && item.labels.empty())
+            continue;
+
+        ++this->image_count;
+        if (!this->coco_path.empty())
+            this->write_coco(item);
+    }
+
+    return;
+}
+
+void DatasetExporter::read_item(ExportItem &item, string &buffer)
+{
+    /*
+    Image size from the header and labels in the classes of `names`, boxes of unknown classes are dropped.
+    */
+
+    item.dropped = 0;
+    item.readable = read_image_size(item.image_path, item.width, item.height);
+    if (!item.readable)
+        return;
+
+    ExportFolder &folder = this->folders[item.folder];
+    vector<Label> labels;
+
+    if (folder.pack)
+    {
+        const Label *packed = folder.pack->get(item.frame_id);
+        labels.assign(packed, packed + folder.pack->count(item.frame_id));
+    }
+    else
+    {
+        filesystem::path txt_path = item.image_path;
+        txt_path.replace_extension(".txt");
+        if (LabelParser::read_file(txt_path, buffer))
+        {
+            LabelParser parser(buffer);
+            Label label;
+            ParseResult result;
+            while ((result = parser.next(label)) != PARSE_END)
+                if (result == PARSE_LABEL)
+                    labels.push_back(label);
+        }
+    }
+
+    for (Label &label : labels)
+    {
+        if (label.class_id < 0 || label.class_id >= (int)folder.class_map.size())
+        {
+            ++item.dropped;
+            continue;
+        }
+
+        label.class_id = folder.class_map[label.class_id];
+        item.labels.push_back(label);
+    }
+
+    return;
+}
+
+void DatasetExporter::write_coco(const ExportItem &item)
+{
+    /*
+    Called in order on the main thread, `image_count` is the id of `item`.
+    */
+
+    long long image_id = this->image_count;
+    string file_name = (this->folders[item.folder].relative / item.image_path.filename()).lexically_normal().generic_string();
+
+    this->coco << (image_id > 1 ? ",\n" : "\n")
+               << "{\"id\": " << image_id << ", \"file_name\": \"" << json_escape(file_name)
+               << "\", \"width\": " << item.width << ", \"height\": " << item.height << "}";
+
+    char line[256];
+    for (const Label &label : item.labels)
+    {
+        double x = max((label.cx - label.w / 2) * item.width, 0.0f);
+        double y = max((label.cy - label.h / 2) * item.height, 0.0f);
+        double w = min((double)(label.cx + label.w / 2) * item.width, (double)item.width) - x;
+        double h = min((double)(label.cy + label.h / 2) * item.height, (double)item.height) - y;
+
+        int size = snprintf(line, sizeof(line),
+                            "%s\n{\"id\": %lld, \"image_id\": %lld, \"category_id\": %d, \"bbox\": [%.2f, %.2f, %.2f, %.2f], \"area\": %.2f, \"iscrowd\": 0}",
+                            this->annotation_count > 0 ? "," : "", this->annotation_count + 1, image_id, label.class_id + 1, x, y, w, h, w * h);
+        this->annotations.write(line, size);
+        ++this->annotation_count;
+    }
+
+    return;
+}
+
+void DatasetExporter::write_voc(const ExportItem &item)
+{
+    /*
+    One `NNNNNN.xml` per image in `voc_dir`, same folders as `OUTPUT_DIR`. Called on the workers.
+    */
+
+    ExportFolder &folder = this->folders[item.folder];
+    filesystem::path xml_path = this->voc_dir / folder.relative / item.image_path.filename();
+    xml_path.replace_extension(".xml");
+
+    string xml;
+    xml += "<annotation>\n";
+    xml += "  <folder>" + xml_escape(folder.relative.lexically_normal().generic_string()) + "</folder>\n";
+    xml += "  <filename>" + xml_escape(item.image_path.filename().string()) + "</filename>\n";
+    xml += "  <size>\n    <width>" + to_string(item.width) + "</width>\n    <height>" + to_string(item.height) +
+           "</height>\n    <depth>3</depth>\n  </size>\n";
+
+    for (const Label &label : item.labels)
+    {
+        // VOC boxes are 1-based pixel corners
+        int xmin = min(max((int)lround((label.cx - label.w / 2) * item.width) + 1, 1), item.width);
+        int ymin = min(max((int)lround((label.cy - label.h / 2) * item.height) + 1, 1), item.height);
+        int xmax = min(max((int)lround((label.cx + label.w / 2) * item.width), 1), item.width);
+        int ymax = min(max((int)lround((label.cy + label.h / 2) * item.height), 1), item.height);
+
+        xml += "  <object>\n    <name>" + xml_escape(this->names[label.class_id]) +
+               "</name>\n    <pose>Unspecified</pose>\n    <truncated>0</truncated>\n    <difficult>0</difficult>\n    <bndbox>\n" +
+               "      <xmin>" + to_string(xmin) + "</xmin>\n      <ymin>" + to_string(ymin) + "</ymin>\n" +
+               "      <xmax>" + to_string(xmax) + "</xmax>\n      <ymax>" + to_string(ymax) + "</ymax>\n" +
+               "    </bndbox>\n  </object>\n";
+    }
+    xml += "</annotation>\n";
+
+    ofstream ofs(xml_path, ios::out | ios::binary | ios::trunc);
+    if (!ofs.is_open())
+    {
+        cout << "Fail to open: " << xml_path << endl;
+        exit(1);
+    }
+    ofs.write(xml.data(), xml.size());
+
+    return;
+}
+
+void DatasetExporter::finish_coco()
+{
+    /*
+    Close the image list, append the annotations (streamed from the side file) and the categories.
+    */
+
+    this->annotations.close();
+
+    this->coco << "\n],\n\"annotations\": [";
+    ifstream ifs(this->coco_path.string() + ".annotations", ios::in | ios::binary);
+    if (this->annotation_count > 0)
+        this->coco << ifs.rdbuf();
+    ifs.close();
+
+    this->coco << "\n],\n\"categories\": [";
+    for (size_t i = 0; i < this->names.size(); ++i)
+        this->coco << (i > 0 ? ",\n" : "\n") << "{\"id\": " << i + 1 << ", \"name\": \"" << json_escape(this->names[i]) << "\"}";
+    this->coco << "\n]\n}\n";
+    this->coco.close();
+
+    return;
+}
+
+string DatasetExporter::json_escape(const string &text)
+{
+    string result;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char)c < 0x20)
+        {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            result += code;
+            continue;
+        }
+        result += c;
+    }
+
+    return result;
+}
+
+string DatasetExporter::xml_escape(const string &text)
+{
+    string result;
+    for (char c : text)
+    {
+        if (c == '&')
+            result += "&amp;";
+        else if (c == '<')
+            result += "&lt;";
+        else if (c == '>')
+            result += "&gt;";
+        else if (c == '"')
+            result += "&quot;";
+        else
+            result += c;
+    }
+
+    return result;
+}
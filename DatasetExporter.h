@@ -0,0 +1,80 @@
+#ifndef __DatasetExporter__H
+#define __DatasetExporter__H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <filesystem>
+
+#include "LabelPack.h"
+#include "ThreadPool.h"
+
+struct ExportFolder
+{
+    std::filesystem::path dir;
+    std::filesystem::path relative; // `dir` under the exported folder
+    std::vector<int> class_map;     // Class id of the folder --> index in `DatasetExporter::names`
+    std::unique_ptr<LabelPack> pack;
+};
+
+struct ExportItem
+{
+    int folder;
+    int frame_id;
+    std::filesystem::path image_path;
+
+    bool readable;
+    int width;
+    int height;
+    std::vector<Label> labels;
+    int dropped; // Boxes of a class missing from the names file
+};
+
+class DatasetExporter
+{
+public:
+    DatasetExporter(std::string cfg_file);
+    ~DatasetExporter();
+
+    void run(std::vector<std::string> args);
+
+private:
+    int folder(std::filesystem::path dir);
+    std::vector<std::string> read_names(std::filesystem::path names_path);
+    int class_index(std::string class_name);
+
+    void export_chunk(std::vector<ExportItem> &chunk, ThreadPool &pool);
+    void read_item(ExportItem &item, std::string &buffer);
+    void write_coco(const ExportItem &item);
+    void write_voc(const ExportItem &item);
+    void finish_coco();
+
+    static std::string json_escape(const std::string &text);
+    static std::string xml_escape(const std::string &text);
+
+private:
+    std::filesystem::path output_dir;
+    std::filesystem::path labels_file;
+
+    std::filesystem::path coco_path;
+    std::filesystem::path voc_dir;
+    bool labeled_only;
+    int num_threads;
+    int chunk_frames;
+
+    std::vector<std::string> names;
+    std::vector<ExportFolder> folders;
+    std::map<std::filesystem::path, int> folder_of_dir;
+
+    // Images go straight to `coco_path`, annotations to a side file appended at the end
+    std::ofstream coco;
+    std::ofstream annotations;
+    long long image_count;
+    long long annotation_count;
+    long long skipped;
+    long long dropped_boxes;
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <utility>
+
+#include "DetectionProposer.h"
+#include "StageProfiler.h"
+
+using namespace cv;
+using namespace std;
+
+DetectionProposer::DetectionProposer(ProposerOptions options, vector<int> class_map)
+{
+    /*
+    The model runs on the CPU backend of `cv::dnn`, one batch of `batch_size` frames per forward pass.
+    */
+
+    this->options = options;
+    this->options.batch_size = max(this->options.batch_size, 1);
+    this->options.lookahead = max(this->options.lookahead, this->options.batch_size);
+    this->options.cache_frames = max(this->options.cache_frames, 1);
+    this->class_map = class_map;
+
+    if (this->options.output_format != "yolov5" && this->options.output_format != "darknet")
+        throw runtime_error("`output_format` invalid: " + this->options.output_format + "\nSupport: \"yolov5\", \"darknet\"");
+
+    if (this->options.input_size.area() <= 0)
+        throw runtime_error("`input_size` must be [width, height]");
+
+    try
+    {
+        this->net = dnn::readNet(this->options.model_path, this->options.config_path);
+    }
+    catch (const cv::Exception &e)
+    {
+        throw runtime_error("Fail to load model: " + this->options.model_path + "\n" + e.what());
+    }
+    if (this->net.empty())
+        throw runtime_error("Fail to load model: " + this->options.model_path);
+
+    this->net.setPreferableBackend(dnn::DNN_BACKEND_OPENCV);
+    this->net.setPreferableTarget(dnn::DNN_TARGET_CPU);
+    this->output_names = this->net.getUnconnectedOutLayersNames();
+
+    this->cursor = 0;
+    this->stopping = false;
+}
+
+DetectionProposer::~DetectionProposer()
+{
+    this->stop();
+}
+
+void DetectionProposer::start()
+{
+    this->stopping = false;
+    this->worker = thread(&DetectionProposer::worker_loop, this);
+
+    return;
+}
+
+void DetectionProposer::stop()
+{
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->stopping = true;
+    }
+    this->cv.notify_all();
+
+    if (this->worker.joinable())
+        this->worker.join();
+
+    return;
+}
+
+void DetectionProposer::push(const FramePacket &packet)
+{
+    /*
+    Queue the working frame of `packet`, it is only read, never copied.
+    Frames behind the cursor, too far ahead, already queued or already inferred are ignored.
+    */
+
+    if (packet.frame.empty())
+        return;
+
+    {
+        lock_guard<mutex> lock(this->mtx);
+
+        if (packet.frame_id < this->cursor || packet.frame_id > this->cursor + this->options.lookahead)
+            return;
+        if (this->cache.count(packet.frame_id) > 0 || this->queue.count(packet.frame_id) > 0)
+            return;
+
+        this->queue[packet.frame_id] = packet.frame;
+    }
+    this->cv.notify_all();
+
+    return;
+}
+
+void DetectionProposer::set_cursor(int frame_id)
+{
+    /*
+    Frame on screen. Queued frames behind it are dropped, they would be inferred for nothing.
+    */
+
+    lock_guard<mutex> lock(this->mtx);
+
+    this->cursor = frame_id;
+    this->queue.erase(this->queue.begin(), this->queue.lower_bound(frame_id));
+
+    return;
+}
+
+bool DetectionProposer::get(int frame_id, vector<Label> &proposals)
+{
+    /*
+    Proposals of `frame_id` in the classes of `names`, false while the frame is not inferred yet.
+    Throws what stopped the worker.
+    */
+
+    lock_guard<mutex> lock(this->mtx);
+
+    if (this->error)
+        rethrow_exception(exchange(this->error, nullptr));
+
+    auto it = this->cache.find(frame_id);
+    if (it == this->cache.end())
+        return false;
+
+    proposals = it->second;
+    return true;
+}
+
+int DetectionProposer::pending()
+{
+    lock_guard<mutex> lock(this->mtx);
+    return this->queue.size();
+}
+
+void DetectionProposer::worker_loop()
+{
+    while (true)
+    {
+        vector<int> frame_ids;
+        vector<Mat> frames;
+        {
+            unique_lock<mutex> lock(this->mtx);
+            this->cv.wait(lock, [this]()
+                          { return this->stopping || !this->queue.empty(); });
+
+            if (this->stopping)
+                return;
+
+            // Give the prefetcher a moment to fill the batch, a partial one still runs
+            this->cv.wait_for(lock, chrono::milliseconds(20), [this]()
+                              { return this->stopping || (int)this->queue.size() >= this->options.batch_size; });
+
+            if (this->stopping)
+                return;
+
+            while (!this->queue.empty() && (int)frame_ids.size() < this->options.batch_size)
+            {
+                frame_ids.push_back(this->queue.begin()->first);
+                frames.push_back(this->queue.begin()->second);
+                this->queue.erase(this->queue.begin());
+            }
+        }
+
+        if (frames.empty())
+            continue;
+
+        try
+        {
+            this->infer(frame_ids, frames);
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(this->mtx);
+            this->error = current_exception();
+            return;
+        }
+    }
+}
+
+void DetectionProposer::infer(vector<int> &frame_ids, vector<Mat> &frames)
+{
+    /*
+    One forward pass over the batch. Models exported with a fixed batch of 1 reject a larger one,
+    then the batch size drops to 1 for the rest of the run.
+    */
+
+    ScopedStage stage(STAGE_PROPOSE, frame_ids[0]);
+
+    Mat blob = dnn::blobFromImages(frames, 1.0 / 255, this->options.input_size, Scalar(), true, false);
+    vector<Mat> outputs;
+    try
+    {
+        this->net.setInput(blob);
+        this->net.forward(outputs, this->output_names);
+    }
+    catch (const cv::Exception &e)
+    {
+        if (frames.size() == 1)
+            throw runtime_error("Proposal inference failed on frame " + to_string(frame_ids[0]) + "\n" + e.what());
+
+        cout << "Model rejects a batch of " << frames.size() << ", run one frame at a time" << endl;
+        this->options.batch_size = 1;
+        for (size_t i = 0; i < frames.size(); ++i)
+        {
+            vector<int> single_id(1, frame_ids[i]);
+            vector<Mat> single_frame(1, frames[i]);
+            this->infer(single_id, single_frame);
+        }
+        return;
+    }
+
+    int batch = frames.size();
+    vector<vector<Label>> proposals(batch);
+    for (Mat &output : outputs)
+    {
+        /*
+        [batch, boxes, 5 + classes], or [batch * boxes, 5 + classes] when the layer folds the batch (Darknet).
+        */
+
+        int cols = output.size[output.dims - 1];
+        int rows = output.total() / max(cols, 1) / batch;
+        const float *data = output.ptr<float>();
+
+        for (int b = 0; b < batch; ++b)
+            this->decode(data + (size_t)b * rows * cols, rows, cols, proposals[b]);
+    }
+
+    for (int b = 0; b < batch; ++b)
+        this->store(frame_ids[b], proposals[b]);
+
+    return;
+}
+
+void DetectionProposer::decode(const float *rows, int count, int cols, vector<Label> &proposals)
+{
+    /*
+    Row: cx, cy, w, h, objectness, class scores.
+        "yolov5"  --> box in input pixels, score = objectness * class score
+        "darknet" --> normalized box, the class scores already include the objectness
+    Boxes of each class go through NMS, classes missing from `names` are dropped.
+    */
+
+    if (cols < 6)
+        return;
+
+    bool yolov5 = this->options.output_format == "yolov5";
+    float sx = yolov5 ? 1.0f / this->options.input_size.width : 1.0f;
+    float sy = yolov5 ? 1.0f / this->options.input_size.height : 1.0f;
+
+    map<int, vector<Rect2d>> boxes;
+    map<int, vector<float>> scores;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const float *row = rows + (size_t)i * cols;
+
+        if (yolov5 && row[4] < this->options.conf_threshold)
+            continue;
+
+        const float *best = max_element(row + 5, row + cols);
+        float score = yolov5 ? row[4] * *best : *best;
+        if (score < this->options.conf_threshold)
+            continue;
+
+        int model_class = best - (row + 5);
+        if (model_class >= (int)this->class_map.size() || this->class_map[model_class] < 0)
+            continue;
+
+        float w = row[2] * sx;
+        float h = row[3] * sy;
+        boxes[this->class_map[model_class]].push_back(Rect2d(row[0] * sx - w / 2, row[1] * sy - h / 2, w, h));
+        scores[this->class_map[model_class]].push_back(score);
+    }
+
+    for (auto &it : boxes)
+    {
+        vector<int> keep;
+        dnn::NMSBoxes(it.second, scores[it.first], this->options.conf_threshold, this->options.nms_threshold, keep);
+
+        for (int k : keep)
+        {
+            Rect2d &box = it.second[k];
+            float xmin = min(max((float)box.x, 0.0f), 1.0f);
+            float ymin = min(max((float)box.y, 0.0f), 1.0f);
+            float xmax = min(max((float)(box.x + box.width), 0.0f), 1.0f);
+            float ymax = min(max((float)(box.y + box.height), 0.0f), 1.0f);
+            if (xmax <= xmin || ymax <= ymin)
+                continue;
+
+            proposals.push_back({it.first, (xmin + xmax) / 2, (ymin + ymax) / 2, xmax - xmin, ymax - ymin});
+        }
+    }
+
+    return;
+}
+
+void DetectionProposer::store(int frame_id, vector<Label> &proposals)
+{
+    lock_guard<mutex> lock(this->mtx);
+
+    this->cache[frame_id] = move(proposals);
+    this->cache_order.push_back(frame_id);
+
+    while ((int)this->cache_order.size() > this->options.cache_frames)
+    {
+        this->cache.erase(this->cache_order.front());
+        this->cache_order.pop_front();
+    }
+
+    return;
+}
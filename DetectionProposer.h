@@ -0,0 +1,74 @@
+#ifndef __DetectionProposer__H
+#define __DetectionProposer__H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+
+#include "FramePrefetcher.h"
+#include "LabelPack.h"
+
+struct ProposerOptions
+{
+    bool enable;
+    std::string model_path;    // ONNX model, or Darknet weights
+    std::string config_path;   // Darknet cfg, empty for ONNX
+    std::string names_file;    // Classes of the model, empty means `labels_file`
+    std::string output_format; // "yolov5": boxes in input pixels and objectness, "darknet": normalized boxes
+    cv::Size input_size;
+    int batch_size;
+    int lookahead;   // Frames queued ahead of the cursor
+    int cache_frames; // Frames whose proposals are kept
+    float conf_threshold;
+    float nms_threshold;
+};
+
+class DetectionProposer
+{
+public:
+    DetectionProposer(ProposerOptions options, std::vector<int> class_map);
+    ~DetectionProposer();
+
+    void start();
+    void stop();
+
+    void push(const FramePacket &packet);
+    void set_cursor(int frame_id);
+    bool get(int frame_id, std::vector<Label> &proposals);
+    int pending();
+
+private:
+    void worker_loop();
+    void infer(std::vector<int> &frame_ids, std::vector<cv::Mat> &frames);
+    void decode(const float *rows, int count, int cols, std::vector<Label> &proposals);
+    void store(int frame_id, std::vector<Label> &proposals);
+
+private:
+    ProposerOptions options;
+    std::vector<int> class_map; // Class of the model --> class of `names`, -1 when not labeled
+
+    cv::dnn::Net net;
+    std::vector<std::string> output_names;
+
+    std::map<int, cv::Mat> queue; // Working frames waiting for inference, nearest the cursor first
+    std::unordered_map<int, std::vector<Label>> cache;
+    std::deque<int> cache_order; // Oldest first, evicted beyond `cache_frames`
+    int cursor;
+
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping;
+    std::exception_ptr error; // Failure of the worker, thrown again by `get`
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+
+#include "EditJournal.h"
+#include "LabelParser.h"
+
+using namespace std;
+
+static const char EDIT_JOURNAL_MAGIC[8] = {'L', 'B', 'L', 'J', 'R', 'N', 'L', '\0'};
+static const uint32_t EDIT_JOURNAL_VERSION = 1;
+
+static_assert(sizeof(EditJournalHeader) == 16, "`EditJournalHeader` layout changed");
+static_assert(sizeof(EditRecordHeader) == 16, "`EditRecordHeader` layout changed");
+
+EditJournal::EditJournal()
+{
+    this->fd = -1;
+    this->end = 0;
+}
+
+EditJournal::~EditJournal()
+{
+    this->close();
+}
+
+vector<LabelEdit> EditJournal::open(filesystem::path journal_path)
+{
+    /*
+    Open `journal_path` for appending, created when it does not exist.
+    Returns the edits it holds, the ones made since the label files were last written.
+    A torn record at the end (crash while appending) is dropped and the file cut before it.
+    */
+
+    this->close();
+    this->journal_path = journal_path;
+
+    vector<LabelEdit> edits;
+    string data;
+    if (filesystem::exists(journal_path) && !LabelParser::read_file(journal_path, data))
+        throw runtime_error("Fail to open: " + journal_path.string());
+
+    this->fd = ::open(journal_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (this->fd < 0)
+        throw runtime_error("Fail to open: " + journal_path.string());
+
+    size_t pos = parse(journal_path, data, edits);
+    if (pos == 0)
+    {
+        // New journal, or one cut before its header was complete
+        EditJournalHeader header;
+        memcpy(header.magic, EDIT_JOURNAL_MAGIC, sizeof(EDIT_JOURNAL_MAGIC));
+        header.version = EDIT_JOURNAL_VERSION;
+        header.record_size = sizeof(Label);
+
+        if (ftruncate(this->fd, 0) != 0 || pwrite(this->fd, &header, sizeof(header), 0) != sizeof(header))
+            throw runtime_error("Fail to write: " + journal_path.string());
+        this->end = sizeof(header);
+
+        return edits;
+    }
+
+    if (pos < data.size())
+    {
+        cout << "Drop " << data.size() - pos << " bytes of a torn record: " << journal_path << endl;
+        if (ftruncate(this->fd, pos) != 0)
+            throw runtime_error("Fail to write: " + journal_path.string());
+    }
+    this->end = pos;
+
+    return edits;
+}
+
+vector<LabelEdit> EditJournal::read(filesystem::path journal_path)
+{
+    /*
+    Edits of `journal_path` without opening it for writing, a torn record is left in place.
+    No journal, no edits.
+    */
+
+    vector<LabelEdit> edits;
+    string data;
+    if (!filesystem::exists(journal_path))
+        return edits;
+
+    if (!LabelParser::read_file(journal_path, data))
+        throw runtime_error("Fail to open: " + journal_path.string());
+    parse(journal_path, data, edits);
+
+    return edits;
+}
+
+size_t EditJournal::parse(filesystem::path journal_path, const string &data, vector<LabelEdit> &edits)
+{
+    /*
+    Edits of the journal held in `data`, up to the first torn record.
+    Returns the size of the valid part, 0 when the header is not complete.
+    */
+
+    EditJournalHeader header;
+    if (data.size() < sizeof(header))
+        return 0;
+
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, EDIT_JOURNAL_MAGIC, sizeof(EDIT_JOURNAL_MAGIC)) != 0 ||
+        header.version != EDIT_JOURNAL_VERSION ||
+        header.record_size != sizeof(Label))
+    {
+        throw runtime_error("Invalid edit journal: " + journal_path.string());
+    }
+
+    size_t pos = sizeof(header);
+    while (pos + sizeof(EditRecordHeader) <= data.size())
+    {
+        EditRecordHeader record;
+        memcpy(&record, data.data() + pos, sizeof(record));
+
+        size_t body = sizeof(record) - sizeof(record.checksum) + ((size_t)record.before_count + record.after_count) * sizeof(Label);
+        if (pos + sizeof(record.checksum) + body > data.size() ||
+            checksum((const uint8_t *)data.data() + pos + sizeof(record.checksum), body) != record.checksum)
+            break;
+
+        const Label *labels = (const Label *)(data.data() + pos + sizeof(record));
+        LabelEdit edit;
+        edit.frame_id = record.frame_id;
+        edit.before.assign(labels, labels + record.before_count);
+        edit.after.assign(labels + record.before_count, labels + record.before_count + record.after_count);
+        edits.push_back(move(edit));
+
+        pos += sizeof(record.checksum) + body;
+    }
+
+    return pos;
+}
+
+void EditJournal::close()
+{
+    if (this->fd >= 0)
+        ::close(this->fd);
+
+    this->fd = -1;
+    this->end = 0;
+
+    return;
+}
+
+bool EditJournal::is_open()
+{
+    return this->fd >= 0;
+}
+
+void EditJournal::append(const LabelEdit &edit)
+{
+    /*
+    The record is assembled in memory and written at the end of the file in one call,
+    the cost does not depend on how many frames are labeled.
+    */
+
+    EditRecordHeader record;
+    record.frame_id = edit.frame_id;
+    record.before_count = edit.before.size();
+    record.after_count = edit.after.size();
+
+    size_t size = sizeof(record) + (edit.before.size() + edit.after.size()) * sizeof(Label);
+    this->buffer.resize(size);
+    uint8_t *data = this->buffer.data();
+
+    // An empty label set has no data pointer to copy from
+    if (!edit.before.empty())
+        memcpy(data + sizeof(record), edit.before.data(), edit.before.size() * sizeof(Label));
+    if (!edit.after.empty())
+        memcpy(data + sizeof(record) + edit.before.size() * sizeof(Label), edit.after.data(), edit.after.size() * sizeof(Label));
+    memcpy(data, &record, sizeof(record));
+    record.checksum = checksum(data + sizeof(record.checksum), size - sizeof(record.checksum));
+    memcpy(data, &record.checksum, sizeof(record.checksum));
+
+    if (pwrite(this->fd, data, size, this->end) != (ssize_t)size)
+        throw runtime_error("Fail to write: " + this->journal_path.string());
+    this->end += size;
+
+    return;
+}
+
+void EditJournal::truncate()
+{
+    /*
+    Drop every record, called once all edits are in the label files.
+    */
+
+    if (ftruncate(this->fd, sizeof(EditJournalHeader)) != 0)
+        throw runtime_error("Fail to write: " + this->journal_path.string());
+    this->end = sizeof(EditJournalHeader);
+
+    return;
+}
+
+void EditJournal::drop_before(int64_t offset)
+{
+    /*
+    Drop the records before `offset` (a `size()` taken earlier), called once their edits are in the label files.
+    The records after it are copied behind the header into a new file that replaces the journal,
+    a crash leaves either the old journal or the new one.
+    */
+
+    if (offset >= this->end)
+    {
+        this->truncate();
+        return;
+    }
+
+    size_t tail = this->end - offset;
+    this->buffer.resize(sizeof(EditJournalHeader) + tail);
+    if (pread(this->fd, this->buffer.data(), sizeof(EditJournalHeader), 0) != sizeof(EditJournalHeader) ||
+        pread(this->fd, this->buffer.data() + sizeof(EditJournalHeader), tail, offset) != (ssize_t)tail)
+    {
+        throw runtime_error("Fail to read: " + this->journal_path.string());
+    }
+
+    filesystem::path tmp_path = this->journal_path.string() + ".tmp";
+    int tmp_fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (tmp_fd < 0 || pwrite(tmp_fd, this->buffer.data(), this->buffer.size(), 0) != (ssize_t)this->buffer.size())
+    {
+        if (tmp_fd >= 0)
+            ::close(tmp_fd);
+        throw runtime_error("Fail to write: " + tmp_path.string());
+    }
+
+    filesystem::rename(tmp_path, this->journal_path);
+    ::close(this->fd);
+    this->fd = tmp_fd;
+    this->end = this->buffer.size();
+
+    return;
+}
+
+int64_t EditJournal::size()
+{
+    return this->end;
+}
+
+uint32_t EditJournal::checksum(const uint8_t *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+
+    return hash;
+}
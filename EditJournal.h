@@ -0,0 +1,71 @@
+#ifndef __EditJournal__H
+#define __EditJournal__H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "LabelPack.h"
+
+/*
+Append-only journal of label edits, one file per video:
+
+    EditJournalHeader
+    { EditRecordHeader, Label[before_count], Label[after_count] } per edit
+
+An edit is the whole label set of one frame before and after the change, appended with a single `write`.
+Replaying the `after` sets in order rebuilds every edit that did not reach the label files yet.
+A record cut short by a crash fails its checksum and ends the replay.
+*/
+
+struct EditJournalHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+struct EditRecordHeader
+{
+    uint32_t checksum; // FNV-1a of everything after this field
+    int32_t frame_id;
+    uint32_t before_count;
+    uint32_t after_count;
+};
+
+struct LabelEdit
+{
+    int frame_id;
+    std::vector<Label> before;
+    std::vector<Label> after;
+};
+
+class EditJournal
+{
+public:
+    EditJournal();
+    ~EditJournal();
+
+    std::vector<LabelEdit> open(std::filesystem::path journal_path);
+    static std::vector<LabelEdit> read(std::filesystem::path journal_path);
+    void close();
+    bool is_open();
+
+    void append(const LabelEdit &edit);
+    void truncate();
+    void drop_before(int64_t offset);
+    int64_t size();
+
+private:
+    static size_t parse(std::filesystem::path journal_path, const std::string &data, std::vector<LabelEdit> &edits);
+    static uint32_t checksum(const uint8_t *data, size_t size);
+
+private:
+    std::filesystem::path journal_path;
+    int fd;
+    int64_t end;         // Bytes of valid records, the next append goes here
+    std::vector<uint8_t> buffer; // One record, reused
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <sstream>
+
+#include "ExtractManifest.h"
+#include "FrameIndex.h"
+
+using namespace std;
+
+ExtractManifest::ExtractManifest()
+{
+    this->saved_until = 0;
+    this->completed = false;
+}
+
+ExtractManifest::~ExtractManifest()
+{
+    if (this->ofs.is_open())
+        this->ofs.close();
+}
+
+string ExtractManifest::signature(filesystem::path video_path, string format, int quality, int stride)
+{
+    uint64_t video_size;
+    int64_t video_mtime;
+    FrameIndex::video_signature(video_path, video_size, video_mtime);
+
+    stringstream ss;
+    ss << "video " << video_size << " " << video_mtime << "\n"
+       << "format " << format << " " << quality << " " << stride << "\n";
+
+    return ss.str();
+}
+
+bool ExtractManifest::load(filesystem::path manifest_path, filesystem::path video_path, string format, int quality, int stride)
+{
+    /*
+    Returns false when there is no manifest for this video and these options.
+    */
+
+    this->saved_until = 0;
+    this->completed = false;
+
+    ifstream ifs(manifest_path, ios::in);
+    if (!ifs.is_open())
+        return false;
+
+    string expected = signature(video_path, format, quality, stride);
+    string header, line;
+    for (int i = 0; i < 2 && getline(ifs, line); ++i)
+        header += line + "\n";
+    if (header != expected)
+        return false;
+
+    // A line cut by a crash is not a number, the checkpoint before it stands
+    string key;
+    int frame_id;
+    while (getline(ifs, line))
+    {
+        istringstream iss(line);
+        if (!(iss >> key >> frame_id))
+            continue;
+
+        if (key == "checkpoint")
+            this->saved_until = max(this->saved_until, frame_id);
+        else if (key == "complete")
+        {
+            this->saved_until = frame_id;
+            this->completed = true;
+        }
+    }
+
+    return true;
+}
+
+void ExtractManifest::begin(filesystem::path manifest_path, filesystem::path video_path, string format, int quality, int stride)
+{
+    /*
+    Keep appending to a matching manifest, otherwise start a new one.
+    */
+
+    bool resume = this->load(manifest_path, video_path, format, quality, stride);
+
+    this->ofs.open(manifest_path, resume ? ios::out | ios::app : ios::out | ios::trunc);
+    if (!this->ofs.is_open())
+    {
+        cout << "Fail to open: " << manifest_path << endl;
+        exit(1);
+    }
+
+    // Resuming after a crash, the last line may be cut: start on a line of its own
+    if (resume)
+        this->ofs << "\n"
+                  << flush;
+    else
+        this->ofs << signature(video_path, format, quality, stride) << flush;
+
+    return;
+}
+
+void ExtractManifest::checkpoint(int frame_id)
+{
+    this->saved_until = frame_id;
+    this->ofs << "checkpoint " << frame_id << "\n"
+              << flush;
+
+    return;
+}
+
+void ExtractManifest::complete(int frame_count)
+{
+    this->saved_until = frame_count;
+    this->completed = true;
+    this->ofs << "complete " << frame_count << "\n"
+              << flush;
+
+    return;
+}
+
+int ExtractManifest::last_frame()
+{
+    return this->saved_until;
+}
+
+bool ExtractManifest::is_complete()
+{
+    return this->completed;
+}
@@ -0,0 +1,43 @@
+#ifndef __ExtractManifest__H
+#define __ExtractManifest__H
+
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <filesystem>
+
+/*
+Progress of a frame extraction, `extract.manifest` in the output folder:
+
+    video <size> <mtime>
+    format <format> <quality> <stride>
+    checkpoint <frame_id>   --> every frame up to frame_id is on disk, appended as extraction goes
+    complete <frame_count>  --> last line once the whole video is extracted
+
+A manifest of another video version or other format options is ignored, the extraction starts over.
+*/
+
+class ExtractManifest
+{
+public:
+    ExtractManifest();
+    ~ExtractManifest();
+
+    bool load(std::filesystem::path manifest_path, std::filesystem::path video_path, std::string format, int quality, int stride);
+    void begin(std::filesystem::path manifest_path, std::filesystem::path video_path, std::string format, int quality, int stride);
+    void checkpoint(int frame_id);
+    void complete(int frame_count);
+
+    int last_frame();
+    bool is_complete();
+
+private:
+    static std::string signature(std::filesystem::path video_path, std::string format, int quality, int stride);
+
+private:
+    std::ofstream ofs;
+    int saved_until;
+    bool completed;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "FrameCache.h"
+
+using namespace cv;
+using namespace std;
+
+FrameCache::FrameCache(int budget_mb)
+{
+    this->budget = (size_t)max(budget_mb, 0) * 1024 * 1024;
+    this->used = 0;
+}
+
+FrameCache::~FrameCache()
+{
+}
+
+bool FrameCache::get(int frame_id, FramePacket &packet)
+{
+    auto it = this->lookup.find(frame_id);
+    if (it == this->lookup.end())
+        return false;
+
+    this->entries.splice(this->entries.begin(), this->entries, it->second);
+    packet = *it->second;
+
+    return true;
+}
+
+void FrameCache::put(const FramePacket &packet)
+{
+    /*
+    Keep the working frame of `packet`, the least recently used frames are dropped over budget.
+    The frame is shared, not copied: nobody may draw on it afterwards.
+    */
+
+    auto it = this->lookup.find(packet.frame_id);
+    if (it != this->lookup.end())
+    {
+        this->entries.splice(this->entries.begin(), this->entries, it->second);
+        return;
+    }
+
+    FramePacket entry;
+    entry.frame_id = packet.frame_id;
+    entry.frame = packet.frame;
+    entry.source_size = packet.source_size;
+
+    this->entries.push_front(entry);
+    this->lookup[entry.frame_id] = this->entries.begin();
+    this->used += entry.frame.total() * entry.frame.elemSize();
+
+    this->evict();
+
+    return;
+}
+
+int FrameCache::size()
+{
+    return this->entries.size();
+}
+
+size_t FrameCache::bytes()
+{
+    return this->used;
+}
+
+void FrameCache::evict()
+{
+    while (this->used > this->budget && !this->entries.empty())
+    {
+        FramePacket &entry = this->entries.back();
+        this->used -= entry.frame.total() * entry.frame.elemSize();
+        this->lookup.erase(entry.frame_id);
+        this->entries.pop_back();
+    }
+
+    return;
+}
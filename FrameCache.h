@@ -0,0 +1,35 @@
+#ifndef __FrameCache__H
+#define __FrameCache__H
+
+#include <list>
+#include <unordered_map>
+
+#include <opencv2/opencv.hpp>
+
+#include "FramePrefetcher.h"
+
+class FrameCache
+{
+public:
+    FrameCache(int budget_mb);
+    ~FrameCache();
+
+    bool get(int frame_id, FramePacket &packet);
+    void put(const FramePacket &packet);
+
+    int size();
+    size_t bytes();
+
+private:
+    void evict();
+
+private:
+    // Most recently used first, only the working frame is kept
+    std::list<FramePacket> entries;
+    std::unordered_map<int, std::list<FramePacket>::iterator> lookup;
+
+    size_t budget;
+    size_t used;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include "FrameIndex.h"
+
+using namespace std;
+
+static const char FRAME_INDEX_MAGIC[8] = {'F', 'R', 'M', 'I', 'N', 'D', 'E', 'X'};
+static const uint32_t FRAME_INDEX_VERSION = 1;
+
+FrameIndex::FrameIndex()
+{
+    this->complete = false;
+}
+
+FrameIndex::~FrameIndex()
+{
+}
+
+bool FrameIndex::load(filesystem::path index_path, filesystem::path video_path)
+{
+    /*
+    Returns false when the index does not exist or belongs to another version of the video.
+    A partial index loads, `is_complete` tells it apart.
+    */
+
+    this->clear();
+
+    ifstream ifs(index_path, ios::in | ios::binary);
+    if (!ifs.is_open())
+        return false;
+
+    FrameIndexHeader header;
+    if (!ifs.read((char *)&header, sizeof(header)))
+        return false;
+
+    uint64_t video_size;
+    int64_t video_mtime;
+    this->video_signature(video_path, video_size, video_mtime);
+
+    if (memcmp(header.magic, FRAME_INDEX_MAGIC, sizeof(FRAME_INDEX_MAGIC)) != 0 ||
+        header.version != FRAME_INDEX_VERSION ||
+        header.video_size != video_size ||
+        header.video_mtime != video_mtime)
+        return false;
+
+    this->timestamps.resize(header.frame_count);
+    if (!ifs.read((char *)this->timestamps.data(), header.frame_count * sizeof(double)))
+    {
+        this->clear();
+        return false;
+    }
+    ifs.close();
+    this->complete = header.partial == 0;
+
+    return true;
+}
+
+void FrameIndex::save(filesystem::path index_path, filesystem::path video_path)
+{
+    FrameIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_INDEX_MAGIC, sizeof(FRAME_INDEX_MAGIC));
+    header.version = FRAME_INDEX_VERSION;
+    header.partial = this->complete ? 0 : 1;
+    header.frame_count = this->timestamps.size();
+    this->video_signature(video_path, header.video_size, header.video_mtime);
+
+    filesystem::path tmp_path = index_path;
+    tmp_path += ".tmp";
+
+    ofstream ofs(tmp_path, ios::out | ios::binary | ios::trunc);
+    if (!ofs.is_open())
+    {
+        cout << "Fail to open: " << tmp_path << endl;
+        return;
+    }
+    ofs.write((const char *)&header, sizeof(header));
+    ofs.write((const char *)this->timestamps.data(), this->timestamps.size() * sizeof(double));
+    ofs.close();
+
+    filesystem::rename(tmp_path, index_path);
+    cout << "Saved " << (this->complete ? "" : "partial ") << "frame index of " << this->timestamps.size() << " frames: " << index_path << endl;
+
+    return;
+}
+
+void FrameIndex::clear()
+{
+    this->timestamps.clear();
+    this->complete = false;
+    return;
+}
+
+void FrameIndex::push_back(double msec)
+{
+    this->timestamps.push_back(msec);
+    return;
+}
+
+void FrameIndex::set_complete()
+{
+    this->complete = true;
+    return;
+}
+
+bool FrameIndex::is_complete()
+{
+    return this->complete;
+}
+
+int FrameIndex::frame_count()
+{
+    return this->timestamps.size();
+}
+
+double FrameIndex::msec(int frame_id)
+{
+    return this->timestamps[frame_id - 1];
+}
+
+void FrameIndex::video_signature(filesystem::path video_path, uint64_t &size, int64_t &mtime)
+{
+    error_code ec;
+    size = filesystem::file_size(video_path, ec);
+    mtime = filesystem::last_write_time(video_path, ec).time_since_epoch().count();
+
+    return;
+}
@@ -0,0 +1,51 @@
+#ifndef __FrameIndex__H
+#define __FrameIndex__H
+
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+
+/*
+Timestamp of every frame of a video, built while decoding from the first frame and stored next to the output.
+Used to seek straight to a frame, also on variable frame rate videos.
+An interrupted pass saves a partial index of the frames it reached, the next pass extends it.
+
+    FrameIndexHeader
+    double[frame_count]  --> CAP_PROP_POS_MSEC of frame 1 ... frame_count
+*/
+
+struct FrameIndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t partial;     // 1: decoding stopped before the end, later frames are not indexed
+    uint64_t video_size;  // The index is rebuilt when the video changes
+    int64_t video_mtime;
+    uint64_t frame_count;
+};
+
+class FrameIndex
+{
+public:
+    FrameIndex();
+    ~FrameIndex();
+
+    bool load(std::filesystem::path index_path, std::filesystem::path video_path);
+    void save(std::filesystem::path index_path, std::filesystem::path video_path);
+
+    void clear();
+    void push_back(double msec);
+    void set_complete();
+    bool is_complete();
+
+    int frame_count();
+    double msec(int frame_id);
+
+    static void video_signature(std::filesystem::path video_path, uint64_t &size, int64_t &mtime);
+
+private:
+    std::vector<double> timestamps;
+    bool complete; // Every frame up to the end of the video
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+
+#include "FramePacer.h"
+
+using namespace std;
+
+// A frame is always shown after this many dropped in a row, so a slow loop still updates the window
+static const int PACER_MAX_DROPPED = 8;
+
+FramePacer::FramePacer(double fps)
+{
+    /*
+    Playback clock at `fps` x speed: every frame has a deadline one interval after the previous one.
+    A frame that starts more than one interval late is processed but not drawn, until the loop catches up.
+    */
+
+    this->fps = fps > 0 ? fps : 30;
+    this->processing = 0;
+    this->dropped_total = 0;
+    this->dropped_in_row = 0;
+
+    this->set_speed(1);
+}
+
+FramePacer::~FramePacer()
+{
+}
+
+void FramePacer::set_speed(double speed)
+{
+    this->speed_ = min(max(speed, 1.0 / 8), 8.0);
+    this->interval = chrono::duration_cast<clock::duration>(chrono::duration<double>(1.0 / this->target_fps()));
+    this->reset();
+
+    return;
+}
+
+double FramePacer::speed()
+{
+    return this->speed_;
+}
+
+double FramePacer::target_fps()
+{
+    return this->fps * this->speed_;
+}
+
+void FramePacer::reset()
+{
+    /*
+    Start a new schedule from the next frame: after a pause, a seek or a speed change nothing is owed.
+    */
+
+    this->started = false;
+    this->finished.clear();
+    this->dropped_in_row = 0;
+
+    return;
+}
+
+void FramePacer::begin_frame()
+{
+    this->frame_begin = clock::now();
+    if (!this->started)
+    {
+        this->deadline = this->frame_begin + this->interval;
+        this->started = true;
+    }
+
+    return;
+}
+
+bool FramePacer::should_display()
+{
+    return clock::now() - this->deadline < this->interval || this->dropped_in_row >= PACER_MAX_DROPPED;
+}
+
+int FramePacer::end_frame(bool displayed)
+{
+    /*
+    Milliseconds to wait before the next frame (0 when the frame was dropped), at least 1 otherwise for `waitKey`.
+    */
+
+    clock::time_point now = clock::now();
+
+    double ms = chrono::duration<double, milli>(now - this->frame_begin).count();
+    this->processing = (this->processing > 0) ? this->processing * 0.9 + ms * 0.1 : ms;
+
+    if (displayed)
+        this->dropped_in_row = 0;
+    else
+    {
+        ++this->dropped_total;
+        ++this->dropped_in_row;
+    }
+
+    int wait = displayed ? max((int)ceil(chrono::duration<double, milli>(this->deadline - now).count()), 1) : 0;
+
+    this->finished.push_back(now);
+    while (now - this->finished.front() > chrono::seconds(1))
+        this->finished.pop_front();
+
+    // More than a second behind: start over instead of dropping a second of frames
+    this->deadline += this->interval;
+    if (now - this->deadline > chrono::seconds(1))
+        this->deadline = now + this->interval;
+
+    return wait;
+}
+
+double FramePacer::achieved_fps()
+{
+    if (this->finished.size() < 2)
+        return 0;
+
+    double seconds = chrono::duration<double>(this->finished.back() - this->finished.front()).count();
+    return seconds > 0 ? (this->finished.size() - 1) / seconds : 0;
+}
+
+double FramePacer::processing_ms()
+{
+    return this->processing;
+}
+
+int FramePacer::dropped()
+{
+    return this->dropped_total;
+}
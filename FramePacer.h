@@ -0,0 +1,43 @@
+#ifndef __FramePacer__H
+#define __FramePacer__H
+
+#include <chrono>
+#include <deque>
+
+class FramePacer
+{
+public:
+    FramePacer(double fps);
+    ~FramePacer();
+
+    void set_speed(double speed);
+    double speed();
+    double target_fps();
+    void reset();
+
+    void begin_frame();
+    bool should_display();
+    int end_frame(bool displayed);
+
+    double achieved_fps();
+    double processing_ms();
+    int dropped();
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    double fps;   // Source frame rate
+    double speed_; // Multiplier of `fps`
+    clock::duration interval;
+
+    bool started;
+    clock::time_point deadline; // When the current frame is due on screen
+    clock::time_point frame_begin;
+
+    double processing;          // Moving average, ms
+    std::deque<clock::time_point> finished; // Frames of the last second
+    int dropped_total;
+    int dropped_in_row;
+};
+
+#endif
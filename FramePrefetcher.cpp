@@ -0,0 +1,414 @@
+#include <iostream>
+#include <cmath>
+
+#include "FramePrefetcher.h"
+#include "ImageHeader.h"
+#include "StageProfiler.h"
+
+using namespace cv;
+using namespace std;
+
+FramePrefetcher::FramePrefetcher(int queue_depth, int num_threads, Size frame_size)
+{
+    this->read_from_video = true;
+    this->index_loaded = false;
+    this->index_saved = 0;
+    this->source_fps = 0;
+    this->frames_total = 0;
+
+    this->frame_size = frame_size;
+    this->num_threads = max(num_threads, 1);
+    this->limit = nullptr;
+
+    this->ring.resize(max(queue_depth, 1));
+    this->states.assign(this->ring.size(), SLOT_FREE);
+
+    this->read_pos = 0;
+    this->consume_pos = 0;
+    this->end_pos = -1;
+    this->stopping = false;
+}
+
+FramePrefetcher::~FramePrefetcher()
+{
+    this->stop();
+    if (this->read_from_video)
+        this->cap.release();
+}
+
+void FramePrefetcher::set_limit(Semaphore *limit)
+{
+    /*
+    At most the count of `limit` frames are decoded at once across every prefetcher sharing it.
+    */
+
+    this->limit = limit;
+}
+
+void FramePrefetcher::set_observer(function<void(const FramePacket &)> observer)
+{
+    /*
+    Called on a worker thread with every frame as soon as it is ready, ahead of `next()`.
+    Set before `start()`. The packet is only lent: share its Mats, never draw on them.
+    */
+
+    this->observer = observer;
+}
+
+bool FramePrefetcher::open_video(filesystem::path video_path, filesystem::path index_path)
+{
+    this->read_from_video = true;
+    this->video_path = video_path;
+    this->index_path = index_path;
+    this->index_loaded = this->index.load(index_path, video_path);
+    this->index_saved = this->index.frame_count();
+
+    this->cap.open(video_path);
+    if (this->cap.isOpened())
+        this->source_fps = this->cap.get(CAP_PROP_FPS);
+
+    return this->cap.isOpened();
+}
+
+void FramePrefetcher::open_frames(vector<filesystem::path> frame_paths)
+{
+    /*
+    `frame_paths[i]` is the image of frame `i + 1`.
+    */
+
+    this->read_from_video = false;
+    this->frame_paths = frame_paths;
+    this->frames_total = frame_paths.size();
+
+    // An unreadable image is replaced by a black frame the size of the first readable header
+    this->blank_size = Size(1, 1);
+    int width, height;
+    for (filesystem::path &path : this->frame_paths)
+    {
+        if (read_image_size(path, width, height))
+        {
+            this->blank_size = Size(width, height);
+            break;
+        }
+    }
+
+    return;
+}
+
+void FramePrefetcher::seek(int frame_id)
+{
+    /*
+    Start from `frame_id` instead of the first frame, call before `start()`.
+    Saved frames are simply read from `frame_id` on. Videos use the frame index when it exists.
+    */
+
+    if (frame_id <= 1)
+        return;
+
+    if (this->read_from_video && !this->seek_video(frame_id))
+    {
+        cout << "Seek to frame " << frame_id << " failed, decode from the first frame" << endl;
+        this->cap.set(CAP_PROP_POS_FRAMES, 0);
+        return;
+    }
+
+    this->read_pos = frame_id - 1;
+    this->consume_pos = frame_id - 1;
+
+    return;
+}
+
+bool FramePrefetcher::seek_video(int frame_id)
+{
+    /*
+    The backend seeks to the keyframe before the requested time and decodes forward from it.
+    With the index, the target timestamp is exact, and every grabbed frame is checked against it:
+    frames before the target are skipped, an overshoot retries from an earlier time.
+    Without the index, fall back to the frame number, exact only for constant frame rate videos.
+    */
+
+    if (!this->index_loaded || frame_id > this->index.frame_count())
+    {
+        cout << "No frame index, seek by frame number" << endl;
+        return this->cap.set(CAP_PROP_POS_FRAMES, frame_id - 1);
+    }
+
+    double target = this->index.msec(frame_id);
+    double tolerance = 0.5;
+    double backoff = 0;
+
+    for (int attempt = 0; attempt < 4; ++attempt)
+    {
+        this->cap.set(CAP_PROP_POS_MSEC, max(target - backoff, 0.0));
+
+        double msec = -1;
+        bool first = true;
+        while (this->cap.grab())
+        {
+            msec = this->cap.get(CAP_PROP_POS_MSEC);
+            if (msec >= target - tolerance)
+                break;
+            first = false;
+        }
+
+        if (msec < 0)
+            return false;
+
+        if (fabs(msec - target) <= tolerance)
+        {
+            this->cap.retrieve(this->seeked_frame);
+            return !this->seeked_frame.empty();
+        }
+
+        // Landed after the target on the first grab, start earlier
+        if (first)
+            backoff = backoff * 2 + 1000;
+        else
+            return false;
+    }
+
+    return false;
+}
+
+void FramePrefetcher::start()
+{
+    /*
+    One reader thread claims the ring slots in frame order, `num_threads` workers fill them.
+    Video: the reader decodes (a `VideoCapture` can only be read sequentially), workers resize.
+    Saved frames: workers read, decode and resize, so up to `num_threads` images are decoded at once.
+    Frames are always handed out in order through `next()`.
+    */
+
+    this->reader = thread(&FramePrefetcher::reader_loop, this);
+    for (int i = 0; i < this->num_threads; ++i)
+        this->workers.emplace_back(&FramePrefetcher::worker_loop, this);
+
+    return;
+}
+
+void FramePrefetcher::stop()
+{
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->stopping = true;
+    }
+    this->cv.notify_all();
+
+    if (this->reader.joinable())
+        this->reader.join();
+    for (auto &worker : this->workers)
+        worker.join();
+    this->workers.clear();
+
+    // Decoding stopped before the end: keep the frames indexed so far, the next run seeks with them and goes on
+    if (this->read_from_video && !this->index_path.empty() && !this->index.is_complete() && this->index.frame_count() > this->index_saved)
+    {
+        this->index.save(this->index_path, this->video_path);
+        this->index_saved = this->index.frame_count();
+    }
+
+    return;
+}
+
+bool FramePrefetcher::next(FramePacket &packet)
+{
+    /*
+    Block until the next frame is ready, returns false at the end of the source.
+    */
+
+    unique_lock<mutex> lock(this->mtx);
+
+    int slot = this->consume_pos % this->ring.size();
+    this->cv.wait(lock, [this, slot]()
+                  { return this->stopping || this->states[slot] == SLOT_READY || this->consume_pos == this->end_pos; });
+
+    if (this->states[slot] != SLOT_READY)
+        return false;
+
+    packet = move(this->ring[slot]);
+    this->ring[slot] = FramePacket();
+    this->states[slot] = SLOT_FREE;
+    ++this->consume_pos;
+
+    lock.unlock();
+    this->cv.notify_all();
+
+    return true;
+}
+
+int FramePrefetcher::occupancy()
+{
+    lock_guard<mutex> lock(this->mtx);
+    return this->read_pos - this->consume_pos;
+}
+
+int FramePrefetcher::capacity()
+{
+    return this->ring.size();
+}
+
+int FramePrefetcher::next_frame_id()
+{
+    lock_guard<mutex> lock(this->mtx);
+    return this->consume_pos + 1;
+}
+
+double FramePrefetcher::fps()
+{
+    /*
+    Read once when the video is opened, the reader thread owns `cap` afterwards.
+    */
+
+    return this->source_fps;
+}
+
+filesystem::path FramePrefetcher::frame_path(int frame_id)
+{
+    /*
+    Image of `frame_id` when reading saved frames, empty otherwise.
+    */
+
+    if (this->read_from_video || frame_id < 1 || frame_id > this->frames_total)
+        return filesystem::path();
+    return this->frame_paths[frame_id - 1];
+}
+
+void FramePrefetcher::reader_loop()
+{
+    int depth = this->ring.size();
+
+    while (true)
+    {
+        int slot;
+        {
+            unique_lock<mutex> lock(this->mtx);
+            this->cv.wait(lock, [this, depth]()
+                          { return this->stopping || this->read_pos - this->consume_pos < depth; });
+
+            if (this->stopping)
+                return;
+            slot = this->read_pos % depth;
+        }
+
+        // The slot is free, nobody else touches it until it is marked decoded
+        Mat source;
+        bool ret;
+        if (this->read_from_video)
+        {
+            SemaphoreGuard guard(this->limit);
+            ScopedStage stage(STAGE_DECODE, this->read_pos + 1);
+            ret = this->decode_video(this->read_pos + 1, source);
+        }
+        else
+            ret = this->read_pos < this->frames_total;
+
+        {
+            lock_guard<mutex> lock(this->mtx);
+            if (!ret)
+            {
+                this->end_pos = this->read_pos;
+                this->cv.notify_all();
+                return;
+            }
+
+            this->ring[slot].frame_id = this->read_pos + 1;
+            this->ring[slot].source = source;
+            this->states[slot] = SLOT_DECODED;
+            this->decoded_slots.push(slot);
+            ++this->read_pos;
+        }
+        this->cv.notify_all();
+    }
+}
+
+void FramePrefetcher::worker_loop()
+{
+    while (true)
+    {
+        int slot;
+        {
+            unique_lock<mutex> lock(this->mtx);
+            this->cv.wait(lock, [this]()
+                          { return this->stopping || !this->decoded_slots.empty(); });
+
+            if (this->stopping)
+                return;
+            slot = this->decoded_slots.front();
+            this->decoded_slots.pop();
+        }
+
+        FramePacket &packet = this->ring[slot];
+        if (!this->read_from_video)
+        {
+            SemaphoreGuard guard(this->limit);
+            ScopedStage stage(STAGE_DECODE, packet.frame_id);
+            packet.source = this->decode_frame(packet.frame_id);
+        }
+
+        packet.source_size = packet.source.size();
+
+        // An empty `frame_size` processes the source resolution
+        if (this->frame_size.area() <= 0 || this->frame_size == packet.source_size)
+            packet.frame = packet.source;
+        else
+        {
+            ScopedStage stage(STAGE_RESIZE, packet.frame_id);
+            resize(packet.source, packet.frame, this->frame_size);
+        }
+
+        // The slot still belongs to this worker, nobody can move the packet out yet
+        if (this->observer)
+            this->observer(packet);
+
+        {
+            lock_guard<mutex> lock(this->mtx);
+            this->states[slot] = SLOT_READY;
+        }
+        this->cv.notify_all();
+    }
+}
+
+bool FramePrefetcher::decode_video(int frame_id, Mat &source)
+{
+    if (!this->seeked_frame.empty())
+    {
+        source = this->seeked_frame;
+        this->seeked_frame.release();
+        return true;
+    }
+
+    bool ret = this->cap.read(source);
+
+    // Decoding on from the last indexed frame (the first frame without an index): extend it on the way
+    if (!this->index.is_complete() && !this->index_path.empty() && this->index.frame_count() == frame_id - 1)
+    {
+        if (ret)
+            this->index.push_back(this->cap.get(CAP_PROP_POS_MSEC));
+        else if (frame_id > 1)
+        {
+            this->index.set_complete();
+            this->index.save(this->index_path, this->video_path);
+            this->index_saved = this->index.frame_count();
+            this->index_loaded = true;
+        }
+    }
+
+    return ret;
+}
+
+Mat FramePrefetcher::decode_frame(int frame_id)
+{
+    /*
+    A frame that cannot be read is replaced by a black one, so the frame ids stay in step.
+    It has the processing size, or the size of the source frames when that is empty.
+    */
+
+    Mat source = imread(this->frame_paths[frame_id - 1]);
+    if (source.empty())
+    {
+        cout << "Fail to read: " << this->frame_paths[frame_id - 1] << endl;
+        source = Mat(this->frame_size.area() > 0 ? this->frame_size : this->blank_size, CV_8UC3, Scalar(0, 0, 0));
+    }
+
+    return source;
+}
@@ -0,0 +1,97 @@
+#ifndef __FramePrefetcher__H
+#define __FramePrefetcher__H
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+
+#include <opencv2/opencv.hpp>
+
+#include "FrameIndex.h"
+#include "Semaphore.h"
+
+struct FramePacket
+{
+    int frame_id;
+    cv::Mat source;       // Decoded frame, original resolution
+    cv::Mat frame;        // Clean working frame at the processing resolution, never drawn on
+    cv::Size source_size; // Kept when `source` is dropped, boxes are mapped back to it
+};
+
+class FramePrefetcher
+{
+public:
+    FramePrefetcher(int queue_depth, int num_threads, cv::Size frame_size);
+    ~FramePrefetcher();
+
+    bool open_video(std::filesystem::path video_path, std::filesystem::path index_path);
+    void open_frames(std::vector<std::filesystem::path> frame_paths);
+    void set_limit(Semaphore *limit);
+    void set_observer(std::function<void(const FramePacket &)> observer);
+    void seek(int frame_id);
+    void start();
+    void stop();
+
+    bool next(FramePacket &packet);
+
+    int occupancy();
+    int capacity();
+    int next_frame_id();
+    double fps();
+    std::filesystem::path frame_path(int frame_id);
+
+private:
+    void reader_loop();
+    void worker_loop();
+    bool decode_video(int frame_id, cv::Mat &source);
+    cv::Mat decode_frame(int frame_id);
+    bool seek_video(int frame_id);
+
+private:
+    enum SlotState
+    {
+        SLOT_FREE,
+        SLOT_DECODED,
+        SLOT_READY
+    };
+
+    cv::VideoCapture cap;
+    std::filesystem::path video_path;
+    std::filesystem::path index_path;
+    FrameIndex index;
+    bool index_loaded;
+    int index_saved; // Frames of the index on disk
+    double source_fps; // Frame rate reported by the container, 0 when unknown
+    cv::Mat seeked_frame; // First frame after a seek, already decoded
+
+    bool read_from_video;
+    std::vector<std::filesystem::path> frame_paths;
+    int frames_total;
+    cv::Size blank_size; // Size of the black stand-in for an unreadable image when `frame_size` is empty
+
+    cv::Size frame_size;
+    int num_threads;
+    Semaphore *limit; // Shared by every prefetcher of a batch, null when alone
+    std::function<void(const FramePacket &)> observer;
+
+    std::vector<FramePacket> ring;
+    std::vector<SlotState> states;
+    std::queue<int> decoded_slots;
+
+    int read_pos;    // Next frame to decode (0 based)
+    int consume_pos; // Next frame handed to `next()`
+    int end_pos;     // Frame count once the source is exhausted, -1 before
+
+    std::thread reader;
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+#include "ImageHeader.h"
+
+using namespace std;
+
+static bool read_jpeg_size(ifstream &ifs, int &width, int &height)
+{
+    /*
+    Walk the marker segments after SOI up to the first SOFn, skipping APPn (EXIF, thumbnails) by their length.
+    */
+
+    uint8_t marker[2];
+    while (ifs.read((char *)marker, 2))
+    {
+        if (marker[0] != 0xFF)
+            return false;
+
+        // Fill bytes
+        while (marker[1] == 0xFF)
+            if (!ifs.read((char *)&marker[1], 1))
+                return false;
+
+        uint8_t type = marker[1];
+        if (type == 0xD8 || type == 0x01 || (type >= 0xD0 && type <= 0xD7))
+            continue;
+        if (type == 0xD9 || type == 0xDA)
+            return false;
+
+        uint8_t length[2];
+        if (!ifs.read((char *)length, 2))
+            return false;
+        int segment = (length[0] << 8) | length[1];
+        if (segment < 2)
+            return false;
+
+        // SOF0 - SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+        if (type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC)
+        {
+            uint8_t sof[5];
+            if (!ifs.read((char *)sof, 5))
+                return false;
+            height = (sof[1] << 8) | sof[2];
+            width = (sof[3] << 8) | sof[4];
+            return width > 0 && height > 0;
+        }
+
+        ifs.seekg(segment - 2, ios::cur);
+    }
+
+    return false;
+}
+
+static bool read_webp_size(const uint8_t *header, int &width, int &height)
+{
+    /*
+    RIFF header, then the first chunk: "VP8 " (lossy), "VP8L" (lossless) or "VP8X" (extended).
+    */
+
+    const uint8_t *chunk = header + 12;
+    const uint8_t *data = chunk + 8;
+
+    if (memcmp(chunk, "VP8 ", 4) == 0)
+    {
+        // Frame tag (3), start code (3), then 14-bit width and height
+        width = (data[6] | (data[7] << 8)) & 0x3FFF;
+        height = (data[8] | (data[9] << 8)) & 0x3FFF;
+    }
+    else if (memcmp(chunk, "VP8L", 4) == 0)
+    {
+        // Signature byte, then 14-bit width - 1 and height - 1
+        uint32_t bits = data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t)data[4] << 24);
+        width = (bits & 0x3FFF) + 1;
+        height = ((bits >> 14) & 0x3FFF) + 1;
+    }
+    else if (memcmp(chunk, "VP8X", 4) == 0)
+    {
+        // Flags (4), then 24-bit width - 1 and height - 1
+        width = (data[4] | (data[5] << 8) | (data[6] << 16)) + 1;
+        height = (data[7] | (data[8] << 8) | (data[9] << 16)) + 1;
+    }
+    else
+        return false;
+
+    return width > 0 && height > 0;
+}
+
+bool read_image_size(const filesystem::path &image_path, int &width, int &height)
+{
+    ifstream ifs(image_path, ios::in | ios::binary);
+    if (!ifs.is_open())
+        return false;
+
+    uint8_t header[30];
+    ifs.read((char *)header, sizeof(header));
+    size_t size = ifs.gcount();
+    ifs.clear();
+
+    // JPEG: SOI
+    if (size >= 2 && header[0] == 0xFF && header[1] == 0xD8)
+    {
+        ifs.seekg(2);
+        return read_jpeg_size(ifs, width, height);
+    }
+
+    // PNG: signature, then the IHDR chunk with big-endian width and height
+    static const uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (size >= 24 && memcmp(header, PNG_SIGNATURE, 8) == 0 && memcmp(header + 12, "IHDR", 4) == 0)
+    {
+        width = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+        height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+        return width > 0 && height > 0;
+    }
+
+    if (size >= 30 && memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WEBP", 4) == 0)
+        return read_webp_size(header, width, height);
+
+    return false;
+}
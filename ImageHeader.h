@@ -0,0 +1,12 @@
+#ifndef __ImageHeader__H
+#define __ImageHeader__H
+
+#include <filesystem>
+
+/*
+Size of a JPEG, PNG or WebP image from the first bytes of the file, without decoding it.
+Returns false for other formats or a damaged header.
+*/
+bool read_image_size(const std::filesystem::path &image_path, int &width, int &height);
+
+#endif
@@ -0,0 +1,119 @@
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "KeyframeInterpolator.h"
+
+using namespace std;
+
+static inline float field(const Label &label, int i)
+{
+    return i == 0 ? label.cx : i == 1 ? label.cy : i == 2 ? label.w : label.h;
+}
+
+KeyframeInterpolator::KeyframeInterpolator(string method)
+{
+    if (method != "linear" && method != "spline")
+        throw runtime_error("Unknown interpolation method: " + method + "\nSupport: linear, spline");
+    this->spline = (method == "spline");
+}
+
+KeyframeInterpolator::~KeyframeInterpolator()
+{
+}
+
+void KeyframeInterpolator::add(int object_id, int frame_id, Label label)
+{
+    /*
+    Keyframes of one object are added in frame order.
+    */
+
+    this->objects[object_id].push_back({frame_id, label});
+
+    return;
+}
+
+int KeyframeInterpolator::keyframe_count()
+{
+    int count = 0;
+    for (auto &it : this->objects)
+        count += it.second.size();
+
+    return count;
+}
+
+void KeyframeInterpolator::fill(map<int, vector<Label>> &frames, bool with_keyframes)
+{
+    /*
+    Append the box of every object to each frame between its first and last keyframe.
+    */
+
+    for (auto &it : this->objects)
+    {
+        vector<Keyframe> &keys = it.second;
+
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            if (with_keyframes)
+                frames[keys[i].frame_id].push_back(keys[i].label);
+
+            if (i + 1 == keys.size())
+                break;
+
+            for (int frame_id = keys[i].frame_id + 1; frame_id < keys[i + 1].frame_id; ++frame_id)
+                frames[frame_id].push_back(this->interpolate(keys, i, frame_id));
+        }
+    }
+
+    return;
+}
+
+float KeyframeInterpolator::tangent(const vector<Keyframe> &keys, int i, int field_id)
+{
+    /*
+    Slope per frame at keyframe `i`, from its neighbours (one-sided at both ends).
+    */
+
+    int prev = max(i - 1, 0);
+    int next = min(i + 1, (int)keys.size() - 1);
+    if (prev == next)
+        return 0;
+
+    return (field(keys[next].label, field_id) - field(keys[prev].label, field_id)) / (keys[next].frame_id - keys[prev].frame_id);
+}
+
+Label KeyframeInterpolator::interpolate(const vector<Keyframe> &keys, int i, int frame_id)
+{
+    /*
+    Box at `frame_id`, between keyframes `i` and `i + 1`.
+    */
+
+    const Keyframe &a = keys[i];
+    const Keyframe &b = keys[i + 1];
+
+    float span = b.frame_id - a.frame_id;
+    float t = (frame_id - a.frame_id) / span;
+
+    float values[4];
+    for (int f = 0; f < 4; ++f)
+    {
+        float p0 = field(a.label, f);
+        float p1 = field(b.label, f);
+
+        if (!this->spline)
+        {
+            values[f] = p0 + (p1 - p0) * t;
+            continue;
+        }
+
+        // Cubic Hermite basis, tangents scaled from per frame to the segment
+        float t2 = t * t;
+        float t3 = t2 * t;
+        float m0 = this->tangent(keys, i, f) * span;
+        float m1 = this->tangent(keys, i + 1, f) * span;
+        values[f] = (2 * t3 - 3 * t2 + 1) * p0 + (t3 - 2 * t2 + t) * m0 + (-2 * t3 + 3 * t2) * p1 + (t3 - t2) * m1;
+    }
+
+    // Overshoot of the spline can not make a box negative
+    return Label({a.label.class_id, values[0], values[1], max(values[2], 0.0f), max(values[3], 0.0f)});
+}
@@ -0,0 +1,41 @@
+#ifndef __KeyframeInterpolator__H
+#define __KeyframeInterpolator__H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "LabelPack.h"
+
+struct Keyframe
+{
+    int frame_id;
+    Label label;
+};
+
+/*
+Boxes of the frames between keyframes, per object.
+"linear" blends the two surrounding keyframes, "spline" is a cubic Hermite curve through all keyframes
+of the object (tangents from the neighbouring keyframes), so speed changes follow smoothly.
+*/
+
+class KeyframeInterpolator
+{
+public:
+    KeyframeInterpolator(std::string method);
+    ~KeyframeInterpolator();
+
+    void add(int object_id, int frame_id, Label label);
+    void fill(std::map<int, std::vector<Label>> &frames, bool with_keyframes);
+    int keyframe_count();
+
+private:
+    Label interpolate(const std::vector<Keyframe> &keys, int i, int frame_id);
+    float tangent(const std::vector<Keyframe> &keys, int i, int field);
+
+private:
+    bool spline;
+    std::map<int, std::vector<Keyframe>> objects; // Keyframes of every object, by frame
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+#include "LabelPack.h"
+#include "LabelParser.h"
+
+using namespace std;
+
+static const char LABEL_PACK_MAGIC[8] = {'L', 'B', 'L', 'P', 'A', 'C', 'K', '\0'};
+static const uint32_t LABEL_PACK_VERSION = 1;
+
+static_assert(sizeof(Label) == 20, "`Label` is stored as a fixed-size record");
+static_assert(sizeof(LabelPackHeader) == 48, "`LabelPackHeader` layout changed");
+
+LabelPack::LabelPack()
+{
+    this->fd = -1;
+    this->size = 0;
+    this->data = nullptr;
+
+    this->header = nullptr;
+    this->index = nullptr;
+    this->records = nullptr;
+}
+
+LabelPack::~LabelPack()
+{
+    this->close();
+}
+
+bool LabelPack::open(filesystem::path pack_path)
+{
+    /*
+    Map `pack_path` read-only, returns false when it does not exist.
+    A corrupt container throws, it is never silently replaced.
+    */
+
+    this->close();
+
+    this->fd = ::open(pack_path.c_str(), O_RDONLY);
+    if (this->fd < 0)
+        return false;
+
+    struct stat st;
+    fstat(this->fd, &st);
+    this->size = st.st_size;
+
+    if (this->size < sizeof(LabelPackHeader))
+    {
+        this->close();
+        throw runtime_error("Invalid label pack: " + pack_path.string());
+    }
+
+    void *addr = mmap(nullptr, this->size, PROT_READ, MAP_SHARED, this->fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        this->close();
+        throw runtime_error("Fail to map: " + pack_path.string());
+    }
+    this->data = (const uint8_t *)addr;
+    this->header = (const LabelPackHeader *)this->data;
+
+    if (memcmp(this->header->magic, LABEL_PACK_MAGIC, sizeof(LABEL_PACK_MAGIC)) != 0 ||
+        this->header->version != LABEL_PACK_VERSION ||
+        this->header->record_size != sizeof(Label) ||
+        this->header->index_offset + this->header->frame_count * sizeof(LabelPackIndex) > this->size ||
+        this->header->records_offset + this->header->box_count * sizeof(Label) > this->size)
+    {
+        this->close();
+        throw runtime_error("Invalid label pack: " + pack_path.string());
+    }
+
+    this->index = (const LabelPackIndex *)(this->data + this->header->index_offset);
+    this->records = (const Label *)(this->data + this->header->records_offset);
+
+    return true;
+}
+
+void LabelPack::close()
+{
+    if (this->data != nullptr)
+        munmap((void *)this->data, this->size);
+    if (this->fd >= 0)
+        ::close(this->fd);
+
+    this->fd = -1;
+    this->size = 0;
+    this->data = nullptr;
+
+    this->header = nullptr;
+    this->index = nullptr;
+    this->records = nullptr;
+
+    return;
+}
+
+bool LabelPack::is_open()
+{
+    return this->data != nullptr;
+}
+
+int LabelPack::frame_count()
+{
+    return this->is_open() ? this->header->frame_count : 0;
+}
+
+int LabelPack::count(int frame_id)
+{
+    if (frame_id < 0 || frame_id >= this->frame_count())
+        return 0;
+    return this->index[frame_id].count;
+}
+
+const Label *LabelPack::get(int frame_id)
+{
+    if (this->count(frame_id) == 0)
+        return nullptr;
+    return this->records + this->index[frame_id].first;
+}
+
+void LabelPack::write(filesystem::path pack_path, LabelPack &base, const unordered_map<int, vector<Label>> &frames)
+{
+    /*
+    Write `base` with every frame of `frames` replaced to `pack_path`.
+    The new container is written next to it and renamed over it, so a crash never leaves a partial file.
+    */
+
+    int frame_count = base.frame_count();
+    for (auto &it : frames)
+        frame_count = max(frame_count, it.first + 1);
+
+    vector<LabelPackIndex> index(frame_count);
+    uint64_t box_count = 0;
+    for (int frame_id = 0; frame_id < frame_count; ++frame_id)
+    {
+        auto it = frames.find(frame_id);
+        index[frame_id].first = box_count;
+        index[frame_id].count = (it != frames.end()) ? it->second.size() : base.count(frame_id);
+        box_count += index[frame_id].count;
+    }
+
+    LabelPackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LABEL_PACK_MAGIC, sizeof(LABEL_PACK_MAGIC));
+    header.version = LABEL_PACK_VERSION;
+    header.record_size = sizeof(Label);
+    header.frame_count = frame_count;
+    header.box_count = box_count;
+    header.index_offset = sizeof(LabelPackHeader);
+    header.records_offset = header.index_offset + frame_count * sizeof(LabelPackIndex);
+
+    filesystem::path tmp_path = pack_path;
+    tmp_path += ".tmp";
+
+    ofstream ofs(tmp_path, ios::out | ios::binary | ios::trunc);
+    if (!ofs.is_open())
+        throw runtime_error("Fail to open: " + tmp_path.string());
+
+    ofs.write((const char *)&header, sizeof(header));
+    ofs.write((const char *)index.data(), index.size() * sizeof(LabelPackIndex));
+    for (int frame_id = 0; frame_id < frame_count; ++frame_id)
+    {
+        if (index[frame_id].count == 0)
+            continue;
+
+        auto it = frames.find(frame_id);
+        const Label *labels = (it != frames.end()) ? it->second.data() : base.get(frame_id);
+        ofs.write((const char *)labels, index[frame_id].count * sizeof(Label));
+    }
+    ofs.close();
+
+    if (!ofs)
+        throw runtime_error("Fail to write: " + tmp_path.string());
+    filesystem::rename(tmp_path, pack_path);
+
+    return;
+}
+
+void LabelPack::export_txt(filesystem::path txt_dir)
+{
+    /*
+    Stream every labeled frame to the per-frame YOLO txt layout (`NNNNNN.txt`).
+    Frames are read straight from the mapping, one at a time.
+    */
+
+    int exported = 0;
+    string text;
+    for (int frame_id = 0; frame_id < this->frame_count(); ++frame_id)
+    {
+        int count = this->count(frame_id);
+        if (count == 0)
+            continue;
+
+        stringstream ss;
+        ss << setw(6) << setfill('0') << frame_id;
+        filesystem::path save_txt_path = txt_dir / (ss.str() + ".txt");
+
+        ofstream ofs(save_txt_path, ios::out | ios::binary | ios::trunc);
+        if (!ofs.is_open())
+            throw runtime_error("Fail to open: " + save_txt_path.string());
+
+        const Label *labels = this->get(frame_id);
+        text.resize((size_t)count * LABEL_LINE_MAX);
+        char *end = text.data();
+        for (int i = 0; i < count; ++i)
+            end = LabelParser::format(end, labels[i]);
+        ofs.write(text.data(), end - text.data());
+        ofs.close();
+
+        ++exported;
+    }
+    cout << "Exported " << exported << " label files to " << txt_dir << endl;
+
+    return;
+}
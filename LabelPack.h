@@ -0,0 +1,71 @@
+#ifndef __LabelPack__H
+#define __LabelPack__H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+
+struct Label
+{
+    int class_id;
+    float cx, cy, w, h; // YOLO format, normalized to [0, 1]
+};
+
+/*
+Packed label container, one file per video:
+
+    LabelPackHeader
+    LabelPackIndex[frame_count]  --> indexed by frame id
+    Label[box_count]             --> fixed-size box records, grouped by frame
+
+Every section is naturally aligned, so the file is used in place through `mmap`.
+*/
+
+struct LabelPackHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t frame_count;
+    uint32_t reserved;
+    uint64_t box_count;
+    uint64_t index_offset;
+    uint64_t records_offset;
+};
+
+struct LabelPackIndex
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+class LabelPack
+{
+public:
+    LabelPack();
+    ~LabelPack();
+
+    bool open(std::filesystem::path pack_path);
+    void close();
+    bool is_open();
+
+    int frame_count();
+    int count(int frame_id);
+    const Label *get(int frame_id);
+
+    static void write(std::filesystem::path pack_path, LabelPack &base, const std::unordered_map<int, std::vector<Label>> &frames);
+    void export_txt(std::filesystem::path txt_dir);
+
+private:
+    int fd;
+    size_t size;
+    const uint8_t *data;
+
+    const LabelPackHeader *header;
+    const LabelPackIndex *index;
+    const Label *records;
+};
+
+#endif
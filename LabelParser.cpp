@@ -0,0 +1,177 @@
+#include <charconv>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "LabelParser.h"
+
+using namespace std;
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool parse_number(const char *p, const char *end, int &value, const char *&next)
+{
+    auto result = from_chars(p, end, value);
+    next = result.ptr;
+    if (result.ec != errc())
+        return false;
+
+    // "1.5" was read as class 1 by the old `stoi` parser, the fraction is still dropped
+    if (next < end && *next == '.')
+        for (++next; next < end && *next >= '0' && *next <= '9'; ++next)
+            ;
+    return true;
+}
+
+static inline bool parse_number(const char *p, const char *end, float &value, const char *&next)
+{
+#if defined(__cpp_lib_to_chars)
+    auto result = from_chars(p, end, value);
+    next = result.ptr;
+    return result.ec == errc();
+#else
+    // No floating-point `from_chars` (libstdc++ before GCC 11): `strtof` on a terminated copy of the field
+    char field[64];
+    size_t size = 0;
+    while (p + size < end && !is_space(p[size]) && size + 1 < sizeof(field))
+        ++size;
+    memcpy(field, p, size);
+    field[size] = '\0';
+
+    char *stop;
+    value = strtof(field, &stop);
+    next = p + (stop - field);
+    return stop != field;
+#endif
+}
+
+template <typename T>
+static inline bool parse_field(const char *&p, const char *end, T &value)
+{
+    while (p < end && is_space(*p))
+        ++p;
+
+    // `from_chars` takes no leading '+', the old stream parser did
+    if (p < end && *p == '+')
+        ++p;
+
+    const char *next;
+    if (!parse_number(p, end, value, next) || (next < end && !is_space(*next)))
+        return false;
+
+    p = next;
+    return true;
+}
+
+LabelParser::LabelParser(string_view text)
+{
+    this->text = text;
+    this->pos = 0;
+    this->current_line = 0;
+}
+
+LabelParser::~LabelParser()
+{
+}
+
+ParseResult LabelParser::next(Label &label)
+{
+    /*
+    Next label of the text, blank lines are skipped.
+    PARSE_MALFORMED leaves `line()` and `line_number()` on the bad line, parsing goes on with the next call.
+    */
+
+    while (this->pos < this->text.size())
+    {
+        size_t eol = this->text.find('\n', this->pos);
+        if (eol == string_view::npos)
+            eol = this->text.size();
+
+        this->current = this->text.substr(this->pos, eol - this->pos);
+        this->pos = eol + 1;
+        ++this->current_line;
+
+        const char *begin = this->current.data();
+        const char *end = begin + this->current.size();
+        while (begin < end && is_space(*begin))
+            ++begin;
+        if (begin == end)
+            continue;
+
+        return parse_line(begin, end, label) ? PARSE_LABEL : PARSE_MALFORMED;
+    }
+
+    return PARSE_END;
+}
+
+int LabelParser::line_number()
+{
+    return this->current_line;
+}
+
+string_view LabelParser::line()
+{
+    return this->current;
+}
+
+bool LabelParser::parse_line(const char *begin, const char *end, Label &label)
+{
+    /*
+    Parse one "class_id cx cy w h" line, returns false when the line is malformed.
+    Anything after the 5th field is ignored.
+    */
+
+    const char *p = begin;
+    return parse_field(p, end, label.class_id) &&
+           parse_field(p, end, label.cx) &&
+           parse_field(p, end, label.cy) &&
+           parse_field(p, end, label.w) &&
+           parse_field(p, end, label.h);
+}
+
+char *LabelParser::format(char *out, const Label &label)
+{
+    /*
+    Same text as "%d %f %f %f %f\n", `out` holds at least LABEL_LINE_MAX chars.
+    Returns the end of the line.
+    */
+
+#if defined(__cpp_lib_to_chars)
+    char *end = out + LABEL_LINE_MAX;
+
+    out = to_chars(out, end, label.class_id).ptr;
+    for (float value : {label.cx, label.cy, label.w, label.h})
+    {
+        *out++ = ' ';
+        out = to_chars(out, end, value, chars_format::fixed, 6).ptr;
+    }
+    *out++ = '\n';
+
+    return out;
+#else
+    int size = snprintf(out, LABEL_LINE_MAX, "%d %f %f %f %f\n", label.class_id, label.cx, label.cy, label.w, label.h);
+    return out + min(size, LABEL_LINE_MAX - 1);
+#endif
+}
+
+bool LabelParser::read_file(filesystem::path file_path, string &buffer)
+{
+    /*
+    Whole file in `buffer`, reused between files so a scan allocates once.
+    */
+
+    ifstream ifs(file_path, ios::in | ios::binary | ios::ate);
+    if (!ifs.is_open())
+        return false;
+
+    buffer.resize(ifs.tellg());
+    ifs.seekg(0);
+    ifs.read(buffer.data(), buffer.size());
+
+    return (bool)ifs;
+}
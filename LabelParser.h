@@ -0,0 +1,46 @@
+#ifndef __LabelParser__H
+#define __LabelParser__H
+
+#include <string>
+#include <string_view>
+#include <filesystem>
+
+#include "LabelPack.h"
+
+// Longest line `format` can produce: an int and 4 fixed-point floats, whatever their value
+static const int LABEL_LINE_MAX = 256;
+
+enum ParseResult
+{
+    PARSE_LABEL,
+    PARSE_MALFORMED,
+    PARSE_END
+};
+
+/*
+YOLO "class_id cx cy w h" lines parsed in place with `from_chars`, nothing is allocated per line.
+The view must outlive the parser.
+*/
+
+class LabelParser
+{
+public:
+    LabelParser(std::string_view text);
+    ~LabelParser();
+
+    ParseResult next(Label &label);
+    int line_number();
+    std::string_view line();
+
+    static bool parse_line(const char *begin, const char *end, Label &label);
+    static char *format(char *out, const Label &label);
+    static bool read_file(std::filesystem::path file_path, std::string &buffer);
+
+private:
+    std::string_view text;
+    size_t pos;
+    int current_line;
+    std::string_view current;
+};
+
+#endif
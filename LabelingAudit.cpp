@@ -0,0 +1,461 @@
+#include <yaml-cpp/yaml.h>
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <filesystem>
+
+#include "LabelPack.h"
+#include "LabelParser.h"
+#include "BoxGeometry.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+/*
+Audit of every label under `OUTPUT_DIR`: per-class counts and label problems.
+
+Usage: labeling_audit [config_file] [output_dir]
+
+Every folder holding `NNNNNN.txt` files or a `labels.pack` is one video, the pack wins when both exist.
+Its class names come from the `.names` file copied next to the labels, or from `labels_file` when there is none.
+Frames are checked in parallel on `AUDIT: num_threads` threads.
+*/
+
+// Normalized coordinates are scaled to integers so the box kernel can compare them,
+// the area of a whole-frame box (scale squared) still fits in an int
+static const int AUDIT_BOX_SCALE = 10000;
+
+struct AuditVideo
+{
+    filesystem::path dir;
+    vector<int> class_map; // Class id of the video --> index in `LabelingAudit::names`
+    unique_ptr<LabelPack> pack;
+};
+
+struct AuditItem
+{
+    int video;
+    int frame_id;
+    filesystem::path txt_path; // Empty for a frame of `labels.pack`
+};
+
+struct AuditStats
+{
+    long long frames = 0;
+    long long boxes = 0;
+    long long empty_files = 0;
+    long long malformed_lines = 0;
+    long long out_of_range = 0;
+    long long zero_area = 0;
+    long long unknown_class = 0;
+    long long duplicates = 0;
+
+    vector<long long> class_counts;
+    vector<string> issues;
+};
+
+class LabelingAudit
+{
+public:
+    LabelingAudit(string cfg_file, string output_dir);
+    ~LabelingAudit();
+
+    void run();
+    void report();
+
+private:
+    void find_videos();
+    vector<string> read_names(filesystem::path names_path);
+    int class_index(string class_name);
+
+    void audit_item(AuditItem &item, AuditStats &stats, string &buffer);
+    void audit_labels(const AuditItem &item, const vector<Label> &labels, AuditStats &stats);
+    void merge(AuditStats &stats);
+
+private:
+    filesystem::path output_dir;
+    filesystem::path labels_file;
+    int num_threads;
+    float duplicate_iou;
+    filesystem::path report_path;
+    int print_issues;
+
+    vector<string> names;
+    vector<AuditVideo> videos;
+    vector<AuditItem> items;
+
+    AuditStats total;
+    mutex mtx;
+};
+
+LabelingAudit::LabelingAudit(string cfg_file, string output_dir)
+{
+    YAML::Node config = YAML::LoadFile(cfg_file);
+
+    this->output_dir = (output_dir != "") ? filesystem::path(output_dir) : filesystem::path(config["PATH"]["OUTPUT_DIR"].as<string>());
+    this->labels_file = filesystem::path(config["PATH"]["labels_file"].as<string>());
+
+    this->num_threads = config["AUDIT"]["num_threads"].as<int>();
+    this->duplicate_iou = config["AUDIT"]["duplicate_iou"].as<float>();
+    this->report_path = filesystem::path(config["AUDIT"]["report_path"].as<string>());
+    this->print_issues = config["AUDIT"]["print_issues"].as<int>();
+}
+
+LabelingAudit::~LabelingAudit()
+{
+}
+
+vector<string> LabelingAudit::read_names(filesystem::path names_path)
+{
+    ifstream ifs(names_path, ios::in);
+    if (!ifs.is_open())
+    {
+        cout << "Fail to open: " << names_path << endl;
+        exit(1);
+    }
+
+    vector<string> result;
+    string line;
+    while (getline(ifs, line))
+    {
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line != "")
+            result.push_back(line);
+    }
+
+    return result;
+}
+
+int LabelingAudit::class_index(string class_name)
+{
+    auto it = find(this->names.begin(), this->names.end(), class_name);
+    if (it != this->names.end())
+        return it - this->names.begin();
+
+    this->names.push_back(class_name);
+    return this->names.size() - 1;
+}
+
+void LabelingAudit::find_videos()
+{
+    /*
+    One pass over `output_dir`, label files are grouped by folder.
+    */
+
+    if (!filesystem::is_directory(this->output_dir))
+    {
+        cout << "`OUTPUT_DIR` Not exists: " << this->output_dir << endl;
+        exit(1);
+    }
+
+    map<filesystem::path, int> video_of_dir;
+    map<filesystem::path, filesystem::path> names_of_dir;
+
+    auto video = [&](filesystem::path dir)
+    {
+        auto it = video_of_dir.find(dir);
+        if (it != video_of_dir.end())
+            return it->second;
+
+        this->videos.push_back(AuditVideo());
+        this->videos.back().dir = dir;
+        return video_of_dir[dir] = this->videos.size() - 1;
+    };
+
+    for (auto &file : filesystem::recursive_directory_iterator(this->output_dir))
+    {
+        if (!file.is_regular_file())
+            continue;
+
+        filesystem::path path = file.path();
+        string stem = path.stem().string();
+
+        if (path.extension() == ".names")
+            names_of_dir[path.parent_path()] = path;
+        else if (path.filename() == "labels.pack")
+            this->videos[video(path.parent_path())].pack = make_unique<LabelPack>();
+        else if (path.extension() == ".txt" && !stem.empty() && stem.find_first_not_of("0123456789") == string::npos)
+            this->items.push_back({video(path.parent_path()), stoi(stem), path});
+    }
+
+    vector<string> default_names = this->read_names(this->labels_file);
+
+    // `labels.pack` holds every label of its folder, txt files next to it are only the imported originals
+    this->items.erase(remove_if(this->items.begin(), this->items.end(), [this](const AuditItem &item)
+                                { return this->videos[item.video].pack != nullptr; }),
+                      this->items.end());
+
+    for (AuditVideo &video : this->videos)
+    {
+        auto it = names_of_dir.find(video.dir);
+        vector<string> video_names = (it != names_of_dir.end()) ? this->read_names(it->second) : default_names;
+        for (string &class_name : video_names)
+            video.class_map.push_back(this->class_index(class_name));
+
+        if (!video.pack)
+            continue;
+
+        if (!video.pack->open(video.dir / "labels.pack"))
+        {
+            cout << "Fail to open: " << video.dir / "labels.pack" << endl;
+            exit(1);
+        }
+
+        int index = &video - &this->videos[0];
+        for (int frame_id = 0; frame_id < video.pack->frame_count(); ++frame_id)
+            if (video.pack->count(frame_id) > 0)
+                this->items.push_back({index, frame_id, filesystem::path()});
+    }
+
+    cout << "Audit " << this->items.size() << " labeled frames of " << this->videos.size() << " videos in " << this->output_dir << endl;
+
+    return;
+}
+
+void LabelingAudit::audit_item(AuditItem &item, AuditStats &stats, string &buffer)
+{
+    ++stats.frames;
+
+    if (item.txt_path.empty())
+    {
+        LabelPack &pack = *this->videos[item.video].pack;
+        const Label *labels = pack.get(item.frame_id);
+        this->audit_labels(item, vector<Label>(labels, labels + pack.count(item.frame_id)), stats);
+        return;
+    }
+
+    if (!LabelParser::read_file(item.txt_path, buffer))
+    {
+        stats.issues.push_back(item.txt_path.string() + ": fail to read");
+        return;
+    }
+
+    vector<Label> labels;
+    int malformed = 0;
+    LabelParser parser(buffer);
+    Label label;
+    ParseResult result;
+    while ((result = parser.next(label)) != PARSE_END)
+    {
+        if (result == PARSE_LABEL)
+            labels.push_back(label);
+        else
+        {
+            ++malformed;
+            stats.issues.push_back(item.txt_path.string() + ":" + to_string(parser.line_number()) + ": malformed line: " + string(parser.line()));
+        }
+    }
+    stats.malformed_lines += malformed;
+
+    // Only malformed lines: already reported line by line, the file is not empty
+    if (labels.empty() && malformed == 0)
+    {
+        ++stats.empty_files;
+        stats.issues.push_back(item.txt_path.string() + ": empty label file");
+        return;
+    }
+    if (labels.empty())
+        return;
+
+    this->audit_labels(item, labels, stats);
+
+    return;
+}
+
+void LabelingAudit::audit_labels(const AuditItem &item, const vector<Label> &labels, AuditStats &stats)
+{
+    /*
+    Checks of one frame: unknown class ids, boxes outside [0, 1] or without area, and
+    near-duplicates (same class, IoU >= `duplicate_iou`).
+    */
+
+    const AuditVideo &video = this->videos[item.video];
+    string where = item.txt_path.empty() ? (video.dir / "labels.pack").string() + "#" + to_string(item.frame_id) : item.txt_path.string();
+    const float eps = 1e-6;
+
+    int n = labels.size();
+    stats.boxes += n;
+
+    BoxBatch boxes;
+    boxes.reserve(n);
+
+    for (int i = 0; i < n; ++i)
+    {
+        const Label &label = labels[i];
+        string box = " (box " + to_string(i + 1) + ")";
+
+        if (label.class_id < 0 || label.class_id >= (int)video.class_map.size())
+        {
+            ++stats.unknown_class;
+            stats.issues.push_back(where + ": unknown class id " + to_string(label.class_id) + box);
+        }
+        else
+            ++stats.class_counts[video.class_map[label.class_id]];
+
+        if (label.w <= 0 || label.h <= 0)
+        {
+            ++stats.zero_area;
+            stats.issues.push_back(where + ": zero-area box" + box);
+        }
+        else if (label.cx - label.w / 2 < -eps || label.cy - label.h / 2 < -eps ||
+                 label.cx + label.w / 2 > 1 + eps || label.cy + label.h / 2 > 1 + eps)
+        {
+            ++stats.out_of_range;
+            stats.issues.push_back(where + ": box out of range" + box);
+        }
+
+        // Clipped to the frame, an out of range box cannot overflow the area
+        boxes.push_back(Box({(int)(min(max(label.cx - label.w / 2, 0.0f), 1.0f) * AUDIT_BOX_SCALE),
+                             (int)(min(max(label.cy - label.h / 2, 0.0f), 1.0f) * AUDIT_BOX_SCALE),
+                             (int)(min(max(label.cx + label.w / 2, 0.0f), 1.0f) * AUDIT_BOX_SCALE),
+                             (int)(min(max(label.cy + label.h / 2, 0.0f), 1.0f) * AUDIT_BOX_SCALE)}));
+    }
+
+    // Each box against all the others through the batch kernel, every pair is reported once
+    vector<float> iou(n);
+    for (int i = 0; i < n; ++i)
+    {
+        if (labels[i].w <= 0 || labels[i].h <= 0)
+            continue;
+
+        boxes.iou(boxes.get(i), iou.data());
+        for (int j = i + 1; j < n; ++j)
+        {
+            if (labels[j].class_id == labels[i].class_id && iou[j] >= this->duplicate_iou)
+            {
+                ++stats.duplicates;
+                stats.issues.push_back(where + ": near-duplicate boxes " + to_string(i + 1) + " and " + to_string(j + 1) +
+                                       " (IoU " + to_string(iou[j]) + ")");
+            }
+        }
+    }
+
+    return;
+}
+
+void LabelingAudit::merge(AuditStats &stats)
+{
+    lock_guard<mutex> lock(this->mtx);
+
+    this->total.frames += stats.frames;
+    this->total.boxes += stats.boxes;
+    this->total.empty_files += stats.empty_files;
+    this->total.malformed_lines += stats.malformed_lines;
+    this->total.out_of_range += stats.out_of_range;
+    this->total.zero_area += stats.zero_area;
+    this->total.unknown_class += stats.unknown_class;
+    this->total.duplicates += stats.duplicates;
+
+    for (size_t i = 0; i < stats.class_counts.size(); ++i)
+        this->total.class_counts[i] += stats.class_counts[i];
+
+    this->total.issues.insert(this->total.issues.end(), stats.issues.begin(), stats.issues.end());
+
+    return;
+}
+
+void LabelingAudit::run()
+{
+    /*
+    Frames are split into many more chunks than threads so a slow folder does not hold one thread.
+    Every chunk counts into its own stats, merged once at the end of the chunk.
+    */
+
+    this->find_videos();
+    this->total.class_counts.assign(this->names.size(), 0);
+
+    ThreadPool pool(this->num_threads);
+    int n = this->items.size();
+    int chunks = min(n, pool.size() * 16);
+    if (chunks == 0)
+        return;
+
+    pool.parallel_for(chunks, [&](int chunk)
+                      {
+                          AuditStats stats;
+                          stats.class_counts.assign(this->names.size(), 0);
+                          string buffer;
+
+                          for (int i = (long long)n * chunk / chunks; i < (long long)n * (chunk + 1) / chunks; ++i)
+                              this->audit_item(this->items[i], stats, buffer);
+
+                          this->merge(stats);
+                      });
+
+    sort(this->total.issues.begin(), this->total.issues.end());
+
+    return;
+}
+
+void LabelingAudit::report()
+{
+    cout << endl
+         << left << setw(24) << "class" << right << setw(14) << "boxes" << endl;
+    for (size_t i = 0; i < this->names.size(); ++i)
+        cout << left << setw(24) << this->names[i] << right << setw(14) << this->total.class_counts[i] << endl;
+
+    cout << endl
+         << left << setw(24) << "frames" << right << setw(14) << this->total.frames << endl
+         << left << setw(24) << "boxes" << right << setw(14) << this->total.boxes << endl
+         << left << setw(24) << "empty files" << right << setw(14) << this->total.empty_files << endl
+         << left << setw(24) << "malformed lines" << right << setw(14) << this->total.malformed_lines << endl
+         << left << setw(24) << "unknown class ids" << right << setw(14) << this->total.unknown_class << endl
+         << left << setw(24) << "zero-area boxes" << right << setw(14) << this->total.zero_area << endl
+         << left << setw(24) << "out-of-range boxes" << right << setw(14) << this->total.out_of_range << endl
+         << left << setw(24) << "near-duplicates" << right << setw(14) << this->total.duplicates << endl;
+
+    int shown = min((int)this->total.issues.size(), this->print_issues);
+    if (shown > 0)
+    {
+        cout << endl;
+        for (int i = 0; i < shown; ++i)
+            cout << this->total.issues[i] << endl;
+        if (shown < (int)this->total.issues.size())
+            cout << "... " << this->total.issues.size() - shown << " more" << endl;
+    }
+
+    if (this->report_path.empty())
+        return;
+
+    ofstream ofs(this->report_path);
+    if (!ofs.is_open())
+    {
+        cout << "Fail to open: " << this->report_path << endl;
+        exit(1);
+    }
+    for (string &issue : this->total.issues)
+        ofs << issue << "\n";
+    ofs.close();
+
+    cout << "Issues: " << this->report_path << endl;
+
+    return;
+}
+
+int main(int argc, char **argv)
+{
+    string cfg_file = (argc > 1) ? argv[1] : "./config_LabelTool.yaml";
+    string output_dir = (argc > 2) ? argv[2] : "";
+
+    try
+    {
+        LabelingAudit audit(cfg_file, output_dir);
+        audit.run();
+        audit.report();
+    }
+    catch (const exception &e)
+    {
+        cout << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
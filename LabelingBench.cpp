@@ -0,0 +1,443 @@
+#include <opencv2/opencv.hpp>
+#include <opencv2/tracking.hpp>
+
+#include <unistd.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+
+#include "SemiAutomaticLabelingTool.h"
+
+using namespace cv;
+using namespace std;
+
+/*
+Micro-benchmarks of the labeling hot paths on synthetic data.
+
+Usage: labeling_bench config_file [json_file]
+
+The synthetic video and labels are generated in a temporary folder, which is removed at the end.
+Results are printed as a table and written to `json_file` (default: labeling_bench.json).
+*/
+
+struct BenchResult
+{
+    string name;
+    int iterations;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double total_ms;
+};
+
+// Test hook: the hot paths of the tool are protected, the bench reaches them through this subclass
+class BenchTool : public SemiAutomaticLabel
+{
+public:
+    BenchTool(string cfg_file) : SemiAutomaticLabel(cfg_file) {}
+
+    using SemiAutomaticLabel::generate_colors;
+    using SemiAutomaticLabel::load_labeled_data;
+    using SemiAutomaticLabel::remove_labeled_data;
+    using SemiAutomaticLabel::to_yolo_point;
+    using SemiAutomaticLabel::write_point2txt;
+
+    using SemiAutomaticLabel::out_dir;
+    using SemiAutomaticLabel::names;
+    using SemiAutomaticLabel::annotations;
+};
+
+class LabelingBench
+{
+public:
+    LabelingBench(string cfg_file);
+    ~LabelingBench();
+
+    void run_all();
+    void write_json(filesystem::path json_path);
+
+private:
+    void generate_video();
+    void generate_labels();
+
+    void bench_decode();
+    void bench_resize();
+    void bench_load_labeled_data();
+    void bench_compute_iou();
+    void bench_batch_iou();
+    void bench_crowded_delete();
+    void bench_label_round_trip();
+    void bench_tracker_update();
+
+    void run(string name, int iterations, function<void(int)> fn);
+
+private:
+    BenchTool tool;
+
+    filesystem::path work_dir;
+    filesystem::path video_file;
+
+    int frame_count;
+    Size source_size;
+    Size frame_size;
+    int boxes_per_frame;
+
+    vector<BenchResult> results;
+};
+
+LabelingBench::LabelingBench(string cfg_file) : tool(cfg_file)
+{
+    this->frame_count = 120;
+    this->source_size = Size(1920, 1080);
+    this->frame_size = Size(1366, 768);
+    this->boxes_per_frame = 20;
+
+    this->work_dir = filesystem::temp_directory_path() / ("labeling_bench_" + to_string(getpid()));
+    filesystem::create_directories(this->work_dir / "labels");
+    this->video_file = this->work_dir / "synthetic.avi";
+
+    this->tool.out_dir = this->work_dir / "labels";
+    this->tool.names = {"person", "car", "bicycle", "dog"};
+    this->tool.generate_colors();
+}
+
+LabelingBench::~LabelingBench()
+{
+    this->tool.annotations.close();
+    filesystem::remove_all(this->work_dir);
+}
+
+void LabelingBench::run_all()
+{
+    this->generate_video();
+    this->generate_labels();
+
+    this->bench_decode();
+    this->bench_resize();
+    this->bench_load_labeled_data();
+    this->bench_compute_iou();
+    this->bench_batch_iou();
+    this->bench_crowded_delete();
+    this->bench_label_round_trip();
+    this->bench_tracker_update();
+
+    return;
+}
+
+void LabelingBench::generate_video()
+{
+    /*
+    A textured background with a few moving rectangles, so the decoder and the tracker have real work to do.
+    */
+
+    VideoWriter writer(this->video_file, VideoWriter::fourcc('M', 'J', 'P', 'G'), 30, this->source_size);
+    if (!writer.isOpened())
+    {
+        cout << "Fail to open: " << this->video_file << endl;
+        exit(1);
+    }
+
+    Mat background(this->source_size, CV_8UC3);
+    randu(background, Scalar(0, 0, 0), Scalar(255, 255, 255));
+
+    for (int i = 0; i < this->frame_count; ++i)
+    {
+        Mat frame = background.clone();
+        for (int j = 0; j < 5; ++j)
+        {
+            int x = (100 + j * 300 + i * (j + 2)) % (this->source_size.width - 200);
+            int y = 150 + j * 150;
+            rectangle(frame, Rect(x, y, 160, 120), Scalar(40 * j, 255 - 40 * j, 128), FILLED);
+        }
+        writer.write(frame);
+    }
+    writer.release();
+
+    return;
+}
+
+void LabelingBench::generate_labels()
+{
+    mt19937 rng(0);
+    uniform_real_distribution<float> center(0.1, 0.9);
+    uniform_real_distribution<float> extent(0.02, 0.2);
+
+    for (int frame_id = 1; frame_id <= this->frame_count; ++frame_id)
+    {
+        stringstream ss;
+        ss << setw(6) << setfill('0') << frame_id;
+        ofstream ofs(this->tool.out_dir / (ss.str() + ".txt"));
+
+        for (int i = 0; i < this->boxes_per_frame; ++i)
+            ofs << format("%d %f %f %f %f", i % 4, center(rng), center(rng), extent(rng), extent(rng)) << "\n";
+        ofs.close();
+    }
+
+    return;
+}
+
+void LabelingBench::bench_decode()
+{
+    VideoCapture cap(this->video_file);
+    Mat frame;
+
+    this->run("decode", this->frame_count, [&](int)
+              { cap.read(frame); });
+
+    return;
+}
+
+void LabelingBench::bench_resize()
+{
+    VideoCapture cap(this->video_file);
+    Mat source, frame;
+    cap.read(source);
+
+    this->run("resize_1366x768", 200, [&](int)
+              { resize(source, frame, this->frame_size); });
+
+    return;
+}
+
+void LabelingBench::bench_load_labeled_data()
+{
+    /*
+    Parsing every label file at startup, then drawing the labels of one frame.
+    */
+
+    this->run("load_labels_startup", 1, [&](int)
+              { this->tool.annotations.open(this->tool.out_dir, 1000, "txt"); });
+
+    Mat frame(this->frame_size, CV_8UC3, Scalar(0, 0, 0));
+    this->run("load_labeled_data", this->frame_count, [&](int i)
+              { this->tool.load_labeled_data(frame, i + 1); });
+
+    return;
+}
+
+void LabelingBench::bench_compute_iou()
+{
+    mt19937 rng(1);
+    uniform_int_distribution<int> coord(0, 1300);
+
+    vector<Box> boxes;
+    for (int i = 0; i < 1000; ++i)
+    {
+        int x = coord(rng), y = coord(rng) % 700;
+        boxes.push_back({x, y, x + 10 + coord(rng) % 200, y + 10 + coord(rng) % 200});
+    }
+
+    float sink = 0;
+    this->run("compute_iou_1000", 1000, [&](int i)
+              {
+                  for (auto &box : boxes)
+                      sink += box_iou(boxes[i], box);
+              });
+    if (sink < 0)
+        cout << sink << endl;
+
+    return;
+}
+
+void LabelingBench::bench_batch_iou()
+{
+    /*
+    Same boxes as `compute_iou_1000`, one query against all of them through the SoA kernel.
+    */
+
+    mt19937 rng(1);
+    uniform_int_distribution<int> coord(0, 1300);
+
+    BoxBatch batch;
+    vector<Box> boxes;
+    for (int i = 0; i < 1000; ++i)
+    {
+        int x = coord(rng), y = coord(rng) % 700;
+        boxes.push_back({x, y, x + 10 + coord(rng) % 200, y + 10 + coord(rng) % 200});
+        batch.push_back(boxes.back());
+    }
+
+    vector<float> iou(batch.size());
+    float sink = 0;
+    this->run("batch_iou_1000", 1000, [&](int i)
+              {
+                  batch.iou(boxes[i], iou.data());
+                  sink += iou[i];
+              });
+    if (sink < 0)
+        cout << sink << endl;
+
+    return;
+}
+
+void LabelingBench::bench_crowded_delete()
+{
+    /*
+    Pedestrian-like frame: 500 small boxes, 4 delete boxes applied at once.
+    The frame is restored after every iteration.
+    */
+
+    int w = this->frame_size.width;
+    int h = this->frame_size.height;
+    int frame_id = this->frame_count + 1;
+
+    mt19937 rng(2);
+    uniform_real_distribution<float> center(0.05, 0.95);
+    vector<Label> crowd;
+    for (int i = 0; i < 500; ++i)
+        crowd.push_back({i % 4, center(rng), center(rng), 0.02, 0.06});
+
+    vector<Box> delete_boxes({{100, 100, 200, 300}, {500, 200, 600, 400}, {900, 300, 1000, 500}, {1200, 500, 1300, 700}});
+    vector<string> class_names(delete_boxes.size(), "person");
+
+    this->run("crowded_delete_500x4", 200, [&](int)
+              {
+                  this->tool.annotations.set(frame_id, crowd);
+                  this->tool.remove_labeled_data(frame_id, delete_boxes, class_names, w, h);
+              });
+
+    return;
+}
+
+void LabelingBench::bench_label_round_trip()
+{
+    /*
+    Add one box and remove it again with a delete box, then persist the frame.
+    */
+
+    int w = this->frame_size.width;
+    int h = this->frame_size.height;
+    Box pointxy({600, 300, 700, 400});
+    vector<float> yolo_point = this->tool.to_yolo_point(pointxy, w, h);
+
+    this->run("write_remove_round_trip", this->frame_count, [&](int i)
+              {
+                  this->tool.write_point2txt({yolo_point}, {"car"}, i + 1);
+                  this->tool.remove_labeled_data(i + 1, {pointxy}, {"car"}, w, h);
+                  this->tool.annotations.flush();
+              });
+
+    return;
+}
+
+void LabelingBench::bench_tracker_update()
+{
+    VideoCapture cap(this->video_file);
+    vector<Mat> frames;
+    Mat source, frame;
+    while (cap.read(source))
+    {
+        resize(source, frame, this->frame_size);
+        frames.push_back(frame.clone());
+    }
+
+    float sx = (float)this->frame_size.width / this->source_size.width;
+    float sy = (float)this->frame_size.height / this->source_size.height;
+
+    Ptr<Tracker> tracker = TrackerCSRT::create();
+    tracker->init(frames[0], Rect((int)(100 * sx), (int)(150 * sy), (int)(160 * sx), (int)(120 * sy)));
+
+    Rect2i box;
+    this->run("tracker_csrt_update", frames.size() - 1, [&](int i)
+              { tracker->update(frames[i + 1], box); });
+
+    return;
+}
+
+void LabelingBench::run(string name, int iterations, function<void(int)> fn)
+{
+    vector<double> samples;
+    samples.reserve(iterations);
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        auto begin = chrono::steady_clock::now();
+        fn(i);
+        samples.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count());
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = iterations;
+
+    double total = 0;
+    for (double x : samples)
+        total += x;
+    result.total_ms = total / 1000;
+    result.mean_us = iterations > 0 ? total / iterations : 0;
+
+    sort(samples.begin(), samples.end());
+    result.p50_us = samples.empty() ? 0 : samples[samples.size() / 2];
+    result.p99_us = samples.empty() ? 0 : samples[min(samples.size() - 1, (size_t)(samples.size() * 0.99))];
+
+    cout << left << setw(28) << name << right
+         << setw(8) << iterations << " iters"
+         << setw(12) << fixed << setprecision(1) << result.mean_us << " us mean"
+         << setw(12) << result.p50_us << " us p50"
+         << setw(12) << result.p99_us << " us p99" << endl;
+
+    this->results.push_back(result);
+
+    return;
+}
+
+void LabelingBench::write_json(filesystem::path json_path)
+{
+    ofstream ofs(json_path);
+    if (!ofs.is_open())
+    {
+        cout << "Fail to open: " << json_path << endl;
+        exit(1);
+    }
+
+    ofs << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < this->results.size(); ++i)
+    {
+        BenchResult &r = this->results[i];
+        ofs << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+            << ", \"mean_us\": " << r.mean_us << ", \"p50_us\": " << r.p50_us
+            << ", \"p99_us\": " << r.p99_us << ", \"total_ms\": " << r.total_ms << "}"
+            << (i + 1 < this->results.size() ? ",\n" : "\n");
+    }
+    ofs << "  ]\n}\n";
+    ofs.close();
+
+    cout << "Results: " << json_path << endl;
+
+    return;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        cout << "Usage: labeling_bench config_file [json_file]" << endl;
+        return 1;
+    }
+
+    string cfg_file = argv[1];
+    string json_file = (argc > 2) ? argv[2] : "labeling_bench.json";
+
+    try
+    {
+        LabelingBench bench(cfg_file);
+        bench.run_all();
+        bench.write_json(json_file);
+    }
+    catch (const exception &e)
+    {
+        cout << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
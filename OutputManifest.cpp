@@ -0,0 +1,135 @@
+#include <iostream>
+#include <algorithm>
+
+#include "OutputManifest.h"
+
+using namespace std;
+
+OutputManifest::OutputManifest()
+{
+}
+
+OutputManifest::~OutputManifest()
+{
+}
+
+void OutputManifest::scan(filesystem::path out_dir, string frame_format)
+{
+    /*
+    `NNNNNN.<frame_format>` are frames, `NNNNNN.txt` label files, everything else is kept by name.
+    */
+
+    lock_guard<mutex> lock(this->mtx);
+
+    this->out_dir = out_dir;
+    this->frames.clear();
+    this->labels.clear();
+    this->others.clear();
+
+    string frame_ext = "." + frame_format;
+    error_code ec;
+
+    for (auto &file : filesystem::directory_iterator(out_dir, ec))
+    {
+        filesystem::path path = file.path();
+        string stem = path.stem().string();
+        string ext = path.extension().string();
+
+        bool numbered = !stem.empty() && stem.size() <= 9 && stem.find_first_not_of("0123456789") == string::npos;
+        if (numbered && ext == frame_ext)
+        {
+            int frame_id = stoi(stem);
+            if (frame_id >= (int)this->frames.size())
+                this->frames.resize(frame_id + 1, false);
+            this->frames[frame_id] = true;
+        }
+        else if (numbered && ext == ".txt")
+            this->labels[stoi(stem)] = file.file_size(ec);
+        else
+            this->others.push_back(path);
+    }
+
+    if (ec)
+        cout << "Fail to scan: " << out_dir << " (" << ec.message() << ")" << endl;
+
+    return;
+}
+
+bool OutputManifest::has_frame(int frame_id)
+{
+    lock_guard<mutex> lock(this->mtx);
+    return frame_id >= 0 && frame_id < (int)this->frames.size() && this->frames[frame_id];
+}
+
+void OutputManifest::add_frame(int frame_id)
+{
+    lock_guard<mutex> lock(this->mtx);
+
+    if (frame_id >= (int)this->frames.size())
+        this->frames.resize(max(frame_id + 1, (int)this->frames.size() * 2), false);
+    this->frames[frame_id] = true;
+
+    return;
+}
+
+bool OutputManifest::has_label(int frame_id)
+{
+    lock_guard<mutex> lock(this->mtx);
+    return this->labels.find(frame_id) != this->labels.end();
+}
+
+uintmax_t OutputManifest::label_size(int frame_id)
+{
+    lock_guard<mutex> lock(this->mtx);
+
+    auto it = this->labels.find(frame_id);
+    return (it != this->labels.end()) ? it->second : 0;
+}
+
+void OutputManifest::set_label(int frame_id, uintmax_t size)
+{
+    lock_guard<mutex> lock(this->mtx);
+    this->labels[frame_id] = size;
+
+    return;
+}
+
+void OutputManifest::remove_label(int frame_id)
+{
+    lock_guard<mutex> lock(this->mtx);
+    this->labels.erase(frame_id);
+
+    return;
+}
+
+vector<int> OutputManifest::label_ids()
+{
+    lock_guard<mutex> lock(this->mtx);
+
+    vector<int> ids;
+    ids.reserve(this->labels.size());
+    for (auto &it : this->labels)
+        ids.push_back(it.first);
+    sort(ids.begin(), ids.end());
+
+    return ids;
+}
+
+void OutputManifest::remove_files(string extension)
+{
+    /*
+    Delete every file of the snapshot with `extension`, no new scan.
+    */
+
+    lock_guard<mutex> lock(this->mtx);
+
+    auto it = partition(this->others.begin(), this->others.end(), [&extension](const filesystem::path &path)
+                        { return path.extension() != extension; });
+
+    error_code ec;
+    for (auto removed = it; removed != this->others.end(); ++removed)
+        filesystem::remove(*removed, ec);
+    this->others.erase(it, this->others.end());
+
+    return;
+}
@@ -0,0 +1,45 @@
+#ifndef __OutputManifest__H
+#define __OutputManifest__H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <filesystem>
+
+/*
+Snapshot of the output folder, taken with one directory scan and kept up to date by the writers.
+Every "does this frame / label file exist" question is answered from memory, no stat per frame.
+*/
+
+class OutputManifest
+{
+public:
+    OutputManifest();
+    ~OutputManifest();
+
+    void scan(std::filesystem::path out_dir, std::string frame_format);
+
+    bool has_frame(int frame_id);
+    void add_frame(int frame_id);
+
+    bool has_label(int frame_id);
+    uintmax_t label_size(int frame_id);
+    void set_label(int frame_id, uintmax_t size);
+    void remove_label(int frame_id);
+    std::vector<int> label_ids();
+
+    void remove_files(std::string extension);
+
+private:
+    std::filesystem::path out_dir;
+
+    std::vector<bool> frames;                      // Indexed by frame id
+    std::unordered_map<int, uintmax_t> labels;     // Frame id --> size of `NNNNNN.txt`
+    std::vector<std::filesystem::path> others;     // Any other file of the folder
+
+    std::mutex mtx;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include <algorithm>
+
+#include "Semaphore.h"
+
+using namespace std;
+
+Semaphore::Semaphore(int count)
+{
+    this->count = max(count, 1);
+}
+
+Semaphore::~Semaphore()
+{
+}
+
+void Semaphore::acquire()
+{
+    unique_lock<mutex> lock(this->mtx);
+    this->cv.wait(lock, [this]()
+                  { return this->count > 0; });
+    --this->count;
+
+    return;
+}
+
+void Semaphore::release()
+{
+    {
+        lock_guard<mutex> lock(this->mtx);
+        ++this->count;
+    }
+    this->cv.notify_one();
+
+    return;
+}
+
+SemaphoreGuard::SemaphoreGuard(Semaphore *semaphore)
+{
+    this->semaphore = semaphore;
+    if (this->semaphore)
+        this->semaphore->acquire();
+}
+
+SemaphoreGuard::~SemaphoreGuard()
+{
+    if (this->semaphore)
+        this->semaphore->release();
+}
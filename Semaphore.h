@@ -0,0 +1,33 @@
+#ifndef __Semaphore__H
+#define __Semaphore__H
+
+#include <mutex>
+#include <condition_variable>
+
+class Semaphore
+{
+public:
+    Semaphore(int count);
+    ~Semaphore();
+
+    void acquire();
+    void release();
+
+private:
+    int count;
+    std::mutex mtx;
+    std::condition_variable cv;
+};
+
+// Holds one unit of `semaphore` for its scope, a null semaphore means no limit
+class SemaphoreGuard
+{
+public:
+    SemaphoreGuard(Semaphore *semaphore);
+    ~SemaphoreGuard();
+
+private:
+    Semaphore *semaphore;
+};
+
+#endif
@@ -9,15 +9,55 @@
 #include <fstream>
 #include <sstream>
 #include <filesystem>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <deque>
+#include <future>
+#include <stdexcept>
 
 #include "SemiAutomaticLabelingTool.h"
+#include "TrackerPool.h"
+#include "FramePrefetcher.h"
+#include "AsyncFrameWriter.h"
+#include "StageProfiler.h"
+#include "FrameCache.h"
+#include "LabelParser.h"
+#include "KeyframeInterpolator.h"
+#include "ExtractManifest.h"
+#include "ThreadPool.h"
+#include "FramePacer.h"
 
 using namespace cv;
 using namespace std;
 
+// Below this many boxes in a frame, a grid costs more than testing every box
+static const int GRID_MIN_BOXES = 64;
+static const int GRID_CELL_SIZE = 64;
+
+// Normalized keyframe boxes are paired as integer boxes, the area of a whole-frame box still fits in an int
+static const int INTERPOLATE_BOX_SCALE = 10000;
+
 SemiAutomaticLabel::SemiAutomaticLabel()
 {
+    // Before the config is read, `fail` checks it
+    this->batch_job = false;
     this->read_cfg_file("./config_LabelTool.yaml");
+
+    this->extracted_until = 0;
+    this->decode_limit = nullptr;
+    this->write_limit = nullptr;
+}
+
+SemiAutomaticLabel::SemiAutomaticLabel(string cfg_file)
+{
+    // Before the config is read, `fail` checks it
+    this->batch_job = false;
+    this->read_cfg_file(cfg_file);
+
+    this->extracted_until = 0;
+    this->decode_limit = nullptr;
+    this->write_limit = nullptr;
 }
 
 SemiAutomaticLabel::~SemiAutomaticLabel()
@@ -38,15 +78,85 @@ void SemiAutomaticLabel::read_cfg_file(string cfg_path)
 
     this->read_from_video = config["FRAME"]["read_from_video"].as<bool>();
     this->frame_dir_path = filesystem::path(config["FRAME"]["frame_dir_path"].as<string>());
+    vector<int> process_size = config["FRAME"]["process_size"].as<vector<int>>();
+    vector<int> display_size = config["FRAME"]["display_size"].as<vector<int>>();
+    if (process_size.size() != 2 || display_size.size() != 2 || display_size[0] <= 0 || display_size[1] <= 0)
+        this->fail("`process_size` and `display_size` must be [width, height]");
+    this->process_size = Size(process_size[0], process_size[1]);
+    this->display_size = Size(display_size[0], display_size[1]);
 
     this->write_txt = config["OPTION"]["write_txt"].as<bool>();
     this->remove_json = config["OPTION"]["remove_json"].as<bool>();
     this->show_video = config["OPTION"]["show_video"].as<bool>();
     this->delete_one_class = config["OPTION"]["delete_one_class"].as<bool>();
+    this->label_format = config["OPTION"]["label_format"].as<string>();
+    this->undo_actions = config["OPTION"]["undo_actions"].as<int>();
+
+    this->frame_format = config["EXTRACT"]["format"].as<string>();
+    this->frame_quality = config["EXTRACT"]["quality"].as<int>();
+    this->png_compression = config["EXTRACT"]["png_compression"].as<int>();
+    this->extract_stride = max(config["EXTRACT"]["stride"].as<int>(), 1);
+    this->checkpoint_frames = max(config["EXTRACT"]["checkpoint_frames"].as<int>(), 1);
 
     this->get_frame_range = config["ACTION"]["get_frame_range"].as<bool>();
     this->frame_range = config["ACTION"]["frame_range"].as<vector<int>>();
     this->start_mode = config["ACTION"]["start_mode"].as<string>();
+    this->scrub_step = config["ACTION"]["scrub_step"].as<int>();
+    this->playback_fps = config["ACTION"]["playback_fps"].as<double>();
+
+    this->tracker_threads = config["TRACKER"]["num_threads"].as<int>();
+    this->tracker_options.backend = config["TRACKER"]["backend"].as<string>();
+    this->tracker_options.search_window = config["TRACKER"]["search_window"].as<float>();
+    this->tracker_options.max_window_size = config["TRACKER"]["max_window_size"].as<int>();
+    this->tracker_options.latency_budget_ms = config["TRACKER"]["latency_budget_ms"].as<float>();
+
+    this->seed_file = config["PROPAGATE"]["seed_file"].as<string>();
+    for (auto seed : config["PROPAGATE"]["seed_boxes"])
+        this->seed_boxes.push_back({seed[0].as<string>(), {seed[1].as<float>(), seed[2].as<float>(), seed[3].as<float>(), seed[4].as<float>()}});
+    this->max_lost_frames = config["PROPAGATE"]["max_lost_frames"].as<int>();
+
+    this->interpolate_source = config["INTERPOLATE"]["source"].as<string>();
+    this->interpolate_method = config["INTERPOLATE"]["method"].as<string>();
+    this->min_stride = max(config["INTERPOLATE"]["min_stride"].as<int>(), 1);
+    this->max_stride = max(config["INTERPOLATE"]["max_stride"].as<int>(), this->min_stride);
+    this->motion_threshold = config["INTERPOLATE"]["motion_threshold"].as<float>();
+    this->max_keyframe_gap = max(config["INTERPOLATE"]["max_keyframe_gap"].as<int>(), 1);
+
+    this->proposer_options.enable = config["PROPOSE"]["enable"].as<bool>();
+    this->proposer_options.model_path = config["PROPOSE"]["model_path"].as<string>();
+    this->proposer_options.config_path = config["PROPOSE"]["config_path"].as<string>();
+    this->proposer_options.names_file = config["PROPOSE"]["names_file"].as<string>();
+    this->proposer_options.output_format = config["PROPOSE"]["output_format"].as<string>();
+    vector<int> input_size = config["PROPOSE"]["input_size"].as<vector<int>>();
+    if (input_size.size() != 2)
+        this->fail("`input_size` must be [width, height]");
+    this->proposer_options.input_size = Size(input_size[0], input_size[1]);
+    this->proposer_options.batch_size = config["PROPOSE"]["batch_size"].as<int>();
+    this->proposer_options.lookahead = config["PROPOSE"]["lookahead"].as<int>();
+    this->proposer_options.cache_frames = config["PROPOSE"]["cache_frames"].as<int>();
+    this->proposer_options.conf_threshold = config["PROPOSE"]["conf_threshold"].as<float>();
+    this->proposer_options.nms_threshold = config["PROPOSE"]["nms_threshold"].as<float>();
+
+    this->render_path = filesystem::path(config["RENDER"]["output_path"].as<string>());
+    this->render_fourcc = config["RENDER"]["fourcc"].as<string>();
+    this->render_fps = config["RENDER"]["fps"].as<double>();
+    vector<int> render_size = config["RENDER"]["frame_size"].as<vector<int>>();
+    if (render_size.size() != 2 || this->render_fourcc.size() != 4)
+        this->fail("`frame_size` must be [width, height] and `fourcc` 4 characters");
+    this->render_size = Size(render_size[0], render_size[1]);
+    this->render_threads = config["RENDER"]["num_threads"].as<int>();
+    this->render_queue_depth = max(config["RENDER"]["queue_depth"].as<int>(), 1);
+    this->render_labeled_only = config["RENDER"]["labeled_only"].as<bool>();
+
+    this->prefetch_depth = config["PIPELINE"]["prefetch_depth"].as<int>();
+    this->prefetch_threads = config["PIPELINE"]["prefetch_threads"].as<int>();
+    this->writer_queue_depth = config["PIPELINE"]["writer_queue_depth"].as<int>();
+    this->writer_threads = config["PIPELINE"]["writer_threads"].as<int>();
+    this->label_flush_ms = config["PIPELINE"]["label_flush_ms"].as<int>();
+    this->frame_cache_mb = config["PIPELINE"]["frame_cache_mb"].as<int>();
+
+    this->profile = config["PROFILE"]["enable"].as<bool>();
+    this->trace_path = filesystem::path(config["PROFILE"]["trace_path"].as<string>());
 
     return;
 }
@@ -64,15 +174,13 @@ void SemiAutomaticLabel::read_labels_file()
 
     if (access(this->labels_file.c_str(), 0))
     {
-        cout << "`labels_file` Not exists: " << this->labels_file << endl;
-        exit(1);
+        this->fail("`labels_file` Not exists: " + this->labels_file.string());
     }
 
     ifstream ifs(this->labels_file, ios::in);
     if (!ifs.is_open())
     {
-        cout << "Fail to open `labels_file`" << endl;
-        exit(1);
+        this->fail("Fail to open `labels_file`");
     }
     string line;
     while (getline(ifs, line))
@@ -112,11 +220,22 @@ void SemiAutomaticLabel::remove_json_file()
     Set `remove_json = True` to remove the json file.
     */
 
-    for (auto &file : filesystem::directory_iterator(this->out_dir))
-    {
-        if (file.path().string().find(".json") != string::npos)
-            filesystem::remove(file.path());
-    }
+    this->outputs.remove_files(".json");
+
+    return;
+}
+
+void SemiAutomaticLabel::set_out_dir()
+{
+    /*
+    Output folder of the video: `OUTPUT_DIR` / video folder / video name
+    */
+
+    filesystem::path mid_path = this->video_path.parent_path();
+    if (this->video_path.string().find("./") != string::npos)
+        mid_path = filesystem::path(this->video_path.parent_path().string().replace(this->video_path.string().find("./"), 2, ""));
+    this->out_dir = this->out_dir / mid_path / this->video_path.stem();
+
     return;
 }
 
@@ -141,127 +260,120 @@ void SemiAutomaticLabel::generate_colors()
     return;
 }
 
-void SemiAutomaticLabel::load_labeled_data(Mat frame, filesystem::path save_txt_path)
+void SemiAutomaticLabel::load_labeled_data(Mat frame, int frame_id)
 {
     /*
-    Read labeled file and draw box to the frame.
+    Read labeled data of the frame and draw box to the frame.
     */
 
-    ifstream ifs(save_txt_path, ios::in);
-
-    if (!ifs.is_open())
-    {
-        cout << "Fail to open: " << save_txt_path << endl;
-        exit(1);
-    }
-    string line, item;
-    int curr, pos;
-    int choiced_class_name;
-    vector<float> box;
-
     int h = frame.rows;
     int w = frame.cols;
 
     int color_len = this->colors.size();
     vector<int> color;
 
-    for (int i = 0; getline(ifs, line); ++i)
+    vector<Label> labels = this->annotations.get(frame_id);
+    for (size_t i = 0; i < labels.size(); ++i)
     {
-        auto it = unique(line.begin(), line.end(), this->isBothSpace);
-        line.erase(it, line.end());
-
-        if (line == "")
-            continue;
-
+        Label &label = labels[i];
         color = this->colors[i % color_len];
 
-        curr = 0;
-        pos = 0;
-
-        box.clear();
-        for (int j = 0; pos != string::npos && pos != -1; ++j)
-        {
-            pos = line.find(" ", curr);
-            item = line.substr(curr, pos - curr);
-            if (j == 0)
-                choiced_class_name = stoi(item);
-            else if (j == 1 || j == 3)
-                box.push_back(stof(item) * w);
-            else if (j == 2 || j == 4)
-                box.push_back(stof(item) * h);
-
-            curr = pos + 1;
-        }
+        int xmin = (int)((label.cx - label.w / 2) * w);
+        int ymin = (int)((label.cy - label.h / 2) * h);
+        int xmax = (int)((label.cx + label.w / 2) * w);
+        int ymax = (int)((label.cy + label.h / 2) * h);
 
-        int xmin = (int)(box[0] - box[2] / 2);
-        int ymin = (int)(box[1] - box[3] / 2);
-        int xmax = (int)(box[0] + box[2] / 2);
-        int ymax = (int)(box[1] + box[3] / 2);
+        string class_name = (label.class_id >= 0 && label.class_id < (int)this->names.size()) ? this->names[label.class_id] : to_string(label.class_id);
 
         rectangle(frame, Point(xmin, ymin), Point(xmax, ymax),
                   Scalar(color[0], color[1], color[2]),
                   3);
-        putText(frame, this->names[choiced_class_name], Point(xmin, ymin - 10), FONT_HERSHEY_DUPLEX, 1,
+        putText(frame, class_name, Point(xmin, ymin - 10), FONT_HERSHEY_DUPLEX, 1,
                 Scalar(color[0], color[1], color[2]),
                 1, LINE_AA);
     }
-    ifs.close();
 
     return;
 }
 
-string SemiAutomaticLabel::remove_space(string line)
+vector<int> SemiAutomaticLabel::proposer_class_map()
 {
-    auto it = unique(line.begin(), line.end(), this->isBothSpace);
-    line.erase(it, line.end());
+    /*
+    Class of the detector --> index in `names`, -1 for classes that are not labeled.
+    The detector classes are read from `names_file`, or are `labels_file` itself when it is empty.
+    */
 
-    line.erase(line.find_last_not_of(" ") + 1);
+    if (this->proposer_options.names_file.empty())
+    {
+        vector<int> class_map(this->names.size());
+        for (size_t i = 0; i < class_map.size(); ++i)
+            class_map[i] = i;
+        return class_map;
+    }
 
-    return line;
+    ifstream ifs(this->proposer_options.names_file, ios::in);
+    if (!ifs.is_open())
+        this->fail("Fail to open `names_file`: " + this->proposer_options.names_file);
+
+    vector<int> class_map;
+    string line;
+    while (getline(ifs, line))
+    {
+        line = this->remove_space(line);
+        if (line == "")
+            continue;
+
+        auto it = find(this->names.begin(), this->names.end(), line);
+        class_map.push_back(it != this->names.end() ? (int)(it - this->names.begin()) : -1);
+    }
+
+    return class_map;
 }
 
-vector<int> SemiAutomaticLabel::point2xyminmax(Rect2i p)
+void SemiAutomaticLabel::draw_proposals(Mat display, const vector<Label> &proposals)
 {
     /*
-    Transfer point [xmin, ymin, w, h] to [xmin, ymin, xmax, ymax]
+    Proposals are drawn thin and gray, they are not labels until accepted.
     */
 
-    vector<int> result;
-    result.push_back((int)p.x);
-    result.push_back((int)p.y);
-    result.push_back((int)(p.x + p.width));
-    result.push_back((int)(p.y + p.height));
+    int h = display.rows;
+    int w = display.cols;
 
-    return result;
+    for (const Label &label : proposals)
+    {
+        int xmin = (int)((label.cx - label.w / 2) * w);
+        int ymin = (int)((label.cy - label.h / 2) * h);
+        int xmax = (int)((label.cx + label.w / 2) * w);
+        int ymax = (int)((label.cy + label.h / 2) * h);
+
+        rectangle(display, Point(xmin, ymin), Point(xmax, ymax), Scalar(200, 200, 200), 1);
+        putText(display, this->names[label.class_id] + "?", Point(xmin, ymax + 20), FONT_HERSHEY_DUPLEX, 0.6,
+                Scalar(200, 200, 200), 1, LINE_AA);
+    }
+
+    return;
 }
 
-vector<int> SemiAutomaticLabel::point2xyminmax(vector<int> p)
+string SemiAutomaticLabel::remove_space(string line)
 {
-    /*
-    Transfer point [xmin, ymin, w, h] to [xmin, ymin, xmax, ymax]
-    */
+    auto it = unique(line.begin(), line.end(), this->isBothSpace);
+    line.erase(it, line.end());
 
-    vector<int> result;
-    result.push_back((int)p[0]);
-    result.push_back((int)p[1]);
-    result.push_back((int)(p[0] + p[2]));
-    result.push_back((int)(p[1] + p[3]));
+    line.erase(line.find_last_not_of(" ") + 1);
 
-    return result;
+    return line;
 }
 
-vector<int> SemiAutomaticLabel::clip(vector<int> p, int w, int h)
+Box SemiAutomaticLabel::point2xyminmax(Rect2i p)
 {
-    vector<int> result;
-    result.push_back(min(max(p[0], 0), w - 1));
-    result.push_back(min(max(p[1], 0), h - 1));
-    result.push_back(min(max(p[2], 0), w - 1));
-    result.push_back(min(max(p[3], 0), h - 1));
+    /*
+    Transfer point [xmin, ymin, w, h] to [xmin, ymin, xmax, ymax]
+    */
 
-    return result;
+    return Box({p.x, p.y, p.x + p.width, p.y + p.height});
 }
 
-void SemiAutomaticLabel::remove_labeled_data(filesystem::path save_txt_path, vector<int> pointxy, string choiced_class_name, int w, int h)
+void SemiAutomaticLabel::remove_labeled_data(int frame_id, vector<Box> delete_boxes, vector<string> class_names, int w, int h, vector<int> actions)
 {
     /*
     When you press 'r', a `delete` box will be drawn and
@@ -269,522 +381,1712 @@ void SemiAutomaticLabel::remove_labeled_data(filesystem::path save_txt_path, vec
 
     if set `delete_one_class = True` only the corresponding
         label class will be deleted.
+
+    All delete boxes of the frame are applied at once. Each one is tested against every box
+    of the frame with the batch kernel, crowded frames hit by several delete boxes go through a grid.
+    With `actions` (one per delete box) the boxes each delete box removed are recorded in its own undo action.
     */
 
-    vector<string> update_line;
-    ifstream ifs(save_txt_path, ios::in);
+    vector<Label> labels = this->annotations.get(frame_id);
+    int n = labels.size();
 
-    if (!ifs.is_open())
+    BoxBatch boxes;
+    boxes.reserve(n);
+    for (Label &label : labels)
     {
-        cout << "Fail to open: " << save_txt_path << endl;
-        exit(1);
+        boxes.push_back(Box({(int)((label.cx - label.w / 2) * w),
+                             (int)((label.cy - label.h / 2) * h),
+                             (int)((label.cx + label.w / 2) * w),
+                             (int)((label.cy + label.h / 2) * h)}));
     }
-    string line, item;
-    int curr, pos;
-    int choiced_class_name_old;
-    vector<float> box;
 
-    for (int i = 0; getline(ifs, line); ++i)
+    auto same_class = [&](int i, int k)
     {
-        auto it = unique(line.begin(), line.end(), this->isBothSpace);
-        line.erase(it, line.end());
-
-        if (line == "")
-            continue;
+        if (!this->delete_one_class)
+            return true;
+        int class_id = labels[i].class_id;
+        return class_id >= 0 && class_id < (int)this->names.size() && this->names[class_id] == class_names[k];
+    };
 
-        curr = 0;
-        pos = 0;
+    // Delete box that removed each label, -1 when kept
+    vector<int> removed(n, -1);
 
-        box.clear();
-
-        for (int j = 0; pos != string::npos && pos != -1; ++j)
-        {
-            pos = line.find(" ", curr);
-            item = line.substr(curr, pos - curr);
-
-            if (j == 0)
-                choiced_class_name_old = stoi(item);
-            else if (j == 1 || j == 3)
-                box.push_back(stof(item) * w);
-            else if (j == 2 || j == 4)
-                box.push_back(stof(item) * h);
-
-            curr = pos + 1;
-        }
-
-        int xmin = (int)(box[0] - box[2] / 2);
-        int ymin = (int)(box[1] - box[3] / 2);
-        int xmax = (int)(box[0] + box[2] / 2);
-        int ymax = (int)(box[1] + box[3] / 2);
-
-        vector<int> box_({xmin, ymin, xmax, ymax});
-
-        float iou = this->compute_iou(pointxy, box_);
+    if (n >= GRID_MIN_BOXES && delete_boxes.size() > 1)
+    {
+        BoxGrid grid(w, h, GRID_CELL_SIZE);
+        grid.build(boxes);
 
-        if (this->delete_one_class)
-        {
-            if (iou > 0 && this->names[choiced_class_name_old] == choiced_class_name)
-            {
-            }
-            else
-                update_line.push_back(line);
-        }
-        else
+        vector<int> ids;
+        for (size_t k = 0; k < delete_boxes.size(); ++k)
         {
-            if (iou == 0)
-                update_line.push_back(line);
+            grid.query(delete_boxes[k], ids);
+            for (int i : ids)
+                if (removed[i] < 0 && box_overlap(boxes.get(i), delete_boxes[k]) > 0 && same_class(i, k))
+                    removed[i] = k;
         }
     }
-    ifs.close();
-
-    if (update_line.size() > 0)
+    else
     {
-        ofstream ofs(save_txt_path);
-        if (!ofs.is_open())
+        vector<float> overlap(n);
+        for (size_t k = 0; k < delete_boxes.size(); ++k)
         {
-            cout << "Fail to open: " << save_txt_path << endl;
-            exit(1);
+            boxes.overlap(delete_boxes[k], overlap.data());
+            for (int i = 0; i < n; ++i)
+                if (removed[i] < 0 && overlap[i] > 0 && same_class(i, k))
+                    removed[i] = k;
         }
-
-        for (string x : update_line)
-            ofs << x + "\n";
-        ofs.close();
     }
 
-    // Exists
-    else if (!access(save_txt_path.c_str(), 0))
-        filesystem::remove(save_txt_path);
-
-    return;
-}
-
-float SemiAutomaticLabel::compute_iou(vector<int> box1, vector<int> box2)
-{
-    int overlap = this->compute_overlap(box1, box2);
-    int union_ = this->compute_area(box1) + this->compute_area(box2) - overlap;
-
-    float iou = (float)overlap / (float)union_;
-
-    return iou;
-}
-
-int SemiAutomaticLabel::compute_overlap(vector<int> box1, vector<int> box2)
-{
-    int xmin = max(box1[0], box2[0]);
-    int ymin = max(box1[1], box2[1]);
-    int xmax = min(box1[2], box2[2]);
-    int ymax = min(box1[3], box2[3]);
-
-    vector<int> box({xmin, ymin, xmax, ymax});
-
-    int area = this->compute_area(box);
+    if (actions.empty())
+    {
+        vector<Label> update_labels;
+        for (int i = 0; i < n; ++i)
+            if (removed[i] < 0)
+                update_labels.push_back(labels[i]);
+
+        if ((int)update_labels.size() != n)
+            this->annotations.set(frame_id, update_labels);
+        return;
+    }
 
-    return area;
-}
+    // One edit per delete box, in order, so each action holds the boxes it removed
+    for (size_t k = 0; k < delete_boxes.size(); ++k)
+    {
+        if (find(removed.begin(), removed.end(), (int)k) == removed.end())
+            continue;
 
-int SemiAutomaticLabel::compute_area(vector<int> box)
-{
-    int w = max(box[2] - box[0], 0);
-    int h = max(box[3] - box[1], 0);
+        vector<Label> update_labels;
+        for (int i = 0; i < n; ++i)
+            if (removed[i] < 0 || removed[i] > (int)k)
+                update_labels.push_back(labels[i]);
+        this->annotations.set(frame_id, update_labels, actions[k]);
+    }
 
-    return w * h;
+    return;
 }
 
-vector<float> SemiAutomaticLabel::to_yolo_point(vector<int> p, bool from_xyminmax, int w, int h)
+vector<float> SemiAutomaticLabel::to_yolo_point(Box p, int w, int h)
 {
     /*
     Transfer to [cx, cy, w, h]
     */
 
-    vector<int> temp;
-    if (from_xyminmax)
-        temp = p;
-    else
-        temp = this->point2xyminmax(p);
-
-    float w_ = (float)(temp[2] - temp[0]);
-    float h_ = (float)(temp[3] - temp[1]);
+    float w_ = (float)(p.xmax - p.xmin);
+    float h_ = (float)(p.ymax - p.ymin);
 
     vector<float> result;
 
-    result.push_back((float)(temp[0] + temp[2]) / 2 / w);
-    result.push_back((float)(temp[1] + temp[3]) / 2 / h);
+    result.push_back((float)(p.xmin + p.xmax) / 2 / w);
+    result.push_back((float)(p.ymin + p.ymax) / 2 / h);
     result.push_back(w_ / w);
     result.push_back(h_ / h);
 
     return result;
 }
 
-void SemiAutomaticLabel::write_point2txt(vector<float> yolo_point, string choiced_class_name, filesystem::path save_txt_path)
+void SemiAutomaticLabel::write_point2txt(vector<vector<float>> yolo_points, vector<string> class_names, int frame_id, int action)
 {
     /*
-    Record box infomation to txt file
+    Record box infomation of one frame.
+    Boxes go to the annotation store, its write-behind thread updates the txt file.
     */
 
-    vector<string> update_line;
-    string line;
+    vector<Label> labels;
 
-    // Exists
-    if (!access(save_txt_path.c_str(), 0))
+    for (size_t i = 0; i < yolo_points.size(); ++i)
     {
-        ifstream ifs(save_txt_path, ios::in);
+        auto it = find(this->names.begin(), this->names.end(), class_names[i]);
 
-        if (!ifs.is_open())
+        if (it != this->names.end())
         {
-            cout << "Fail to open: " << save_txt_path << endl;
-            exit(1);
+            vector<float> &yolo_point = yolo_points[i];
+            labels.push_back({(int)(it - this->names.begin()), yolo_point[0], yolo_point[1], yolo_point[2], yolo_point[3]});
         }
-
-        while (getline(ifs, line))
-            update_line.push_back(line);
-        ifs.close();
-    }
-
-    int idx = 0;
-    bool found = false;
-    for (string x : this->names)
-    {
-        if (x == choiced_class_name)
+        else
         {
-            found = true;
-            break;
+            this->fail(class_names[i] + " Not found in names");
         }
-        ++idx;
     }
 
-    if (found)
-    {
-        line = format("%d %f %f %f %f", idx, yolo_point[0], yolo_point[1], yolo_point[2], yolo_point[3]);
-        update_line.push_back(line);
-    }
-    else
-    {
-        cout << choiced_class_name << " Not found in names" << endl;
-        exit(1);
-    }
-
-    ofstream ofs(save_txt_path);
-    if (!ofs.is_open())
-    {
-        cout << "Fail to open: " << save_txt_path << endl;
-        exit(1);
-    }
-
-    for (string x : update_line)
-        ofs << x + "\n";
-    ofs.close();
+    this->annotations.add(frame_id, labels, action);
 
     return;
 }
 
-void SemiAutomaticLabel::start()
+void SemiAutomaticLabel::replace_point(int frame_id, vector<float> old_point, vector<float> yolo_point, string class_name, int action)
 {
-    bool tracking = false;
-    bool removeItem = false;
-    int display_time = 1;
+    /*
+    Replace the box `old_point` a track saved on the frame with `yolo_point`, the other boxes stay.
+    The old box is only matched exactly, it is added when it is gone (deleted meanwhile).
+    */
 
-    Ptr<Tracker> tracker = TrackerCSRT::create();
+    auto it = find(this->names.begin(), this->names.end(), class_name);
+    if (it == this->names.end())
+        this->fail(class_name + " Not found in names");
+    int class_id = it - this->names.begin();
 
-    this->read_labels_file();
-    string choiced_class_name = "";
+    vector<Label> labels = this->annotations.get(frame_id);
+    for (auto label = labels.rbegin(); label != labels.rend(); ++label)
+    {
+        if (label->class_id == class_id && label->cx == old_point[0] && label->cy == old_point[1] &&
+            label->w == old_point[2] && label->h == old_point[3])
+        {
+            labels.erase(next(label).base());
+            break;
+        }
+    }
+    labels.push_back({class_id, yolo_point[0], yolo_point[1], yolo_point[2], yolo_point[3]});
 
-    this->generate_colors();
+    this->annotations.set(frame_id, labels, action);
 
-    filesystem::path mid_path = this->video_path.parent_path();
-    if (this->video_path.string().find("./") != string::npos)
-        mid_path = filesystem::path(this->video_path.parent_path().string().replace(this->video_path.string().find("./"), 2, ""));
-    out_dir = this->out_dir / mid_path / this->video_path.stem();
+    return;
+}
 
-    // `out_dir` not exists
-    if (access(this->out_dir.c_str(), 0))
-    {
-        this->show_video = false;
-        this->get_frame_range = false;
-        cout << "First time will create folder and catch every frame" << endl
-             << "Set:" << endl
-             << "\tshow_vid: " << (this->show_video ? "True" : "False") << endl
-             << "\tget_frame_range: " << (this->get_frame_range ? "True" : "False") << endl;
-        filesystem::create_directories(this->out_dir);
-    }
+void SemiAutomaticLabel::fail(string message)
+{
+    /*
+    Error of the current video. A batch job throws, the batch logs the video and goes on with the others,
+    the stores of this job are flushed as it unwinds. Anything else stops here.
+    */
 
-    cout << "Output Path: " << this->out_dir << endl;
+    if (this->batch_job)
+        throw runtime_error(message);
 
-    if (this->remove_json)
-        this->remove_json_file();
+    cout << message << endl;
+    exit(1);
+}
 
+void SemiAutomaticLabel::check_frame_range()
+{
     if (this->check_use_frame_range(""))
     {
         if (this->frame_range[0] < 2 || (this->frame_range[0] >= this->frame_range[1] && this->frame_range[1] != -1) || (this->frame_range[1] <= 2 && this->frame_range[1] != -1))
         {
-            cout << endl
-                 << "`frame_range` invalid" << endl
-                 << "Support" << endl
-                 << "start from: 2" << endl
-                 << "end to: -1" << endl
-                 << "Example: [2, 100]" << endl
-                 << "Example: [2, -1]" << endl
-                 << "Example: [10, -1]" << endl;
-            exit(1);
+            this->fail("\n`frame_range` invalid\n"
+                       "Support\n"
+                       "start from: 2\n"
+                       "end to: -1\n"
+                       "Example: [2, 100]\n"
+                       "Example: [2, -1]\n"
+                       "Example: [10, -1]");
         }
         cout << "Use frame range: "
              << "[" << this->frame_range[0] << ", " << this->frame_range[1] << "]" << endl;
     }
 
-    VideoCapture cap;
-    int frames_total = 0;
+    return;
+}
+
+void SemiAutomaticLabel::open_source(FramePrefetcher &prefetcher)
+{
+    /*
+    Open the video or the saved frames as the source of `prefetcher`.
+    */
 
     if (this->read_from_video)
     {
         if (access(this->video_path.c_str(), 0))
         {
-            cout << "`video_path` Not exists!" << endl;
-            exit(1);
+            this->fail("`video_path` Not exists: " + this->video_path.string());
         }
 
         cout << "Read from video: " << this->video_path << endl;
-        cap.open(this->video_path);
 
-        if (!cap.isOpened())
+        // Frames extracted with the current format, see `extract_frames`
+        ExtractManifest manifest;
+        this->extracted_until = 0;
+        if (manifest.load(this->out_dir / "extract.manifest", this->video_path, this->frame_format, this->frame_quality, 1))
+            this->extracted_until = manifest.last_frame();
+
+        if (!prefetcher.open_video(this->video_path, this->out_dir / "frame_index.bin"))
         {
-            cout << "Cannot open camera";
-            exit(1);
+            this->fail("Cannot open camera");
         }
     }
     else
     {
         if (access(this->frame_dir_path.c_str(), 0))
         {
-            cout << "`frame_dir_path` Not exists!" << endl;
-            exit(1);
+            this->fail("`frame_dir_path` Not exists!");
         }
         cout << "Read from frame" << endl;
 
+        // One scan: frame `i` is `NNNNNN.jpg` (or .png, .webp) with NNNNNN = i, frames are used up to the first gap
+        map<int, filesystem::path> found;
         for (auto &file : filesystem::directory_iterator(this->frame_dir_path))
         {
-            if (file.path().string().find(".jpg") != string::npos)
-                ++frames_total;
+            string stem = file.path().stem().string();
+            string ext = file.path().extension().string();
+            if ((ext == ".jpg" || ext == ".png" || ext == ".webp") && !stem.empty() && stem.find_first_not_of("0123456789") == string::npos)
+                found[stoi(stem)] = file.path();
         }
+
+        vector<filesystem::path> frame_paths;
+        for (auto it = found.find(1); it != found.end() && it->first == (int)frame_paths.size() + 1; ++it)
+            frame_paths.push_back(it->second);
+
+        if (frame_paths.size() != found.size())
+            cout << "Frames are not continuous, use frame 1 to " << frame_paths.size() << endl;
+        cout << "Frames: " << frame_paths.size() << endl;
+
+        prefetcher.open_frames(frame_paths);
     }
 
-    filesystem::path target_names_path = this->out_dir / this->video_path.replace_extension("names").filename();
-    // Exists
-    if (!access(target_names_path.c_str(), 0))
-        filesystem::remove(target_names_path);
-    filesystem::copy(this->labels_file, target_names_path);
+    return;
+}
 
-    int frame_id = 0;
+void SemiAutomaticLabel::copy_names_file()
+{
+    filesystem::path target_names_path = this->out_dir / filesystem::path(this->video_path).replace_extension("names").filename();
+    filesystem::copy_file(this->labels_file, target_names_path, filesystem::copy_options::overwrite_existing);
 
-    stringstream ss;
-    filesystem::path save_img_path;
-    filesystem::path save_txt_path;
+    return;
+}
 
-    bool ret;
-    Mat frame;
-    int h, w;
-    int keyName;
+vector<Label> SemiAutomaticLabel::load_seeds(int keyframe, vector<string> seed_args, bool &from_store)
+{
+    /*
+    Seed boxes of the keyframe, the first source that is set wins:
+        1. `--seed class_name,cx,cy,w,h` on the command line
+        2. `seed_file`, a YOLO txt file
+        3. `seed_boxes` in the config file
+        4. Labels already saved for the keyframe
+    Boxes of `seed_file` and of the saved labels whose class id is not in `names` are reported and skipped.
+    A class name not in `names` (`--seed`, `seed_boxes`) is a typo in the command or the config and fails.
+    */
 
-    while (true)
+    vector<Label> seeds;
+    Label label;
+    from_store = false;
+
+    auto known_class = [this](const Label &seed, string source)
     {
-        ++frame_id;
-        string frame_id_str;
-        ss.clear();
-        ss << setw(6) << setfill('0') << frame_id;
-        ss >> frame_id_str;
+        if (seed.class_id >= 0 && seed.class_id < (int)this->names.size())
+            return true;
 
-        save_img_path = this->out_dir / (frame_id_str + ".jpg");
-        save_txt_path = this->out_dir / (frame_id_str + ".txt");
+        cout << "Skip seed of unknown class id " << seed.class_id << " in " << source << endl;
+        return false;
+    };
 
-        if (this->read_from_video)
+    auto class_id = [this](string class_name)
+    {
+        auto it = find(this->names.begin(), this->names.end(), class_name);
+        if (it == this->names.end())
         {
-            ret = cap.read(frame);
-            if (!ret)
-            {
-                cout << "End video" << endl;
-                break;
-            }
-            if (access(save_img_path.c_str(), 0))
-                imwrite(save_img_path, frame);
+            this->fail(class_name + " Not found in names");
         }
-        else
+        return (int)(it - this->names.begin());
+    };
+
+    for (size_t i = 0; i < seed_args.size(); ++i)
+    {
+        if (seed_args[i] != "--seed" || i + 1 >= seed_args.size())
         {
-            if (frame_id > frames_total)
-                break;
-            frame = imread(save_img_path);
+            this->fail("Invalid argument: " + seed_args[i] + "\nExample: --seed car,0.5,0.5,0.2,0.1");
         }
 
-        if (this->check_use_frame_range(""))
-        {
-            if (frame_id == this->frame_range[0] - 1)
-            {
-                resize(frame, frame, Size(1366, 768));
-                putText(frame, to_string(frame_id), Point(70, 50), FONT_HERSHEY_DUPLEX, 1, Scalar(0, 0, 255), 1, LINE_AA);
+        string seed = seed_args[++i];
+        replace(seed.begin(), seed.end(), ',', ' ');
 
-                if (this->show_video)
-                {
-                    imshow(this->video_path, frame);
-                    waitKey(0);
-                }
-            }
-            else if (frame_id < this->frame_range[0])
-                continue;
-            else if (this->frame_range[1] != -1 && frame_id > this->frame_range[1])
-                break;
+        istringstream iss(seed);
+        string class_name;
+        if (!(iss >> class_name >> label.cx >> label.cy >> label.w >> label.h))
+        {
+            this->fail("Invalid seed: " + seed_args[i]);
         }
+        label.class_id = class_id(class_name);
+        seeds.push_back(label);
+    }
+    if (!seeds.empty())
+        return seeds;
 
-        resize(frame, frame, Size(1366, 768));
-        putText(frame, to_string(frame_id), Point(70, 50), FONT_HERSHEY_DUPLEX, 1, Scalar(0, 0, 255), 1, LINE_AA);
-
-        h = frame.rows;
-        w = frame.cols;
+    if (this->seed_file != "")
+    {
+        string buffer;
+        if (!LabelParser::read_file(this->seed_file, buffer))
+        {
+            this->fail("Fail to open: " + this->seed_file.string());
+        }
 
-        // Exists
-        if (!access(save_txt_path.c_str(), 0))
+        LabelParser parser(buffer);
+        ParseResult result;
+        while ((result = parser.next(label)) != PARSE_END)
         {
-            if (filesystem::file_size(save_txt_path) == 0)
-                filesystem::remove(save_txt_path);
+            if (result == PARSE_LABEL)
+            {
+                if (known_class(label, this->seed_file.string() + ":" + to_string(parser.line_number())))
+                    seeds.push_back(label);
+            }
             else
-                this->load_labeled_data(frame, save_txt_path);
+                cout << "Skip malformed line " << parser.line_number() << " in " << this->seed_file << ": " << parser.line() << endl;
         }
+        return seeds;
+    }
 
-        keyName = waitKey(display_time);
+    for (auto &seed : this->seed_boxes)
+    {
+        label.class_id = class_id(seed.first);
+        label.cx = seed.second[0];
+        label.cy = seed.second[1];
+        label.w = seed.second[2];
+        label.h = seed.second[3];
+        seeds.push_back(label);
+    }
+    if (!seeds.empty())
+        return seeds;
 
-        // Exit
-        if (keyName == 'q')
-            break;
+    from_store = true;
+    for (Label &stored : this->annotations.get(keyframe))
+        if (known_class(stored, "the labels of frame " + to_string(keyframe)))
+            seeds.push_back(stored);
 
-        // Pause video
-        else if (keyName == ' ')
-            waitKey(0);
+    return seeds;
+}
 
-        // Draw 1 box
-        else if (keyName == 'a' || (this->check_use_frame_range("a") && frame_id == this->frame_range[0]))
-        {
-            this->start_mode = "";
-            string input_msg = "==================================================";
-            cout << input_msg << endl;
-            this->print_labels();
-            cout << "Input Class Name: ";
-            getline(cin, choiced_class_name);
+void SemiAutomaticLabel::propagate(vector<string> seed_args)
+{
+    /*
+    Headless propagation: no window, no key and no console input.
+    The seed boxes of the keyframe (`frame_range[0]`, or the first frame) are tracked forward
+    until `frame_range[1]` or the end, every tracked box is saved through `write_point2txt`.
+    */
 
-            choiced_class_name = this->remove_space(choiced_class_name);
+    this->read_labels_file();
+    this->set_out_dir();
 
-            while (find(this->names.begin(), this->names.end(), choiced_class_name) == this->names.end())
-            {
-                cout << choiced_class_name << " not in names please input again" << endl;
-                cout << input_msg << endl;
-                this->print_labels();
-                cout << "Input Class Name: ";
-                getline(cin, choiced_class_name);
+    // `out_dir` not exists
+    if (access(this->out_dir.c_str(), 0))
+        filesystem::create_directories(this->out_dir);
+    cout << "Output Path: " << this->out_dir << endl;
 
-                choiced_class_name = this->remove_space(choiced_class_name);
-            }
+    this->outputs.scan(this->out_dir, this->frame_format);
+    this->annotations.set_outputs(&this->outputs);
+    this->annotations.open(this->out_dir, this->label_flush_ms, this->label_format);
 
-            auto area = selectROI(this->video_path, frame, false, false);
-            tracker = TrackerCSRT::create();
-            tracker->init(frame, area);
-            tracking = true;
-        }
+    this->check_frame_range();
+    int keyframe = this->check_use_frame_range("") ? this->frame_range[0] : 1;
+    int last_frame = this->check_use_frame_range("") ? this->frame_range[1] : -1;
 
-        // Cancel tracking
-        else if (keyName == 'c')
-        {
-            tracking = false;
-            removeItem = false;
-        }
+    bool from_store;
+    vector<Label> seeds = this->load_seeds(keyframe, seed_args, from_store);
+    if (seeds.empty())
+    {
+        this->fail("No seed boxes for keyframe " + to_string(keyframe));
+    }
+    cout << "Propagate " << seeds.size() << " seed boxes from frame " << keyframe << endl;
 
-        // Slow down
-        else if (keyName == '1')
-            display_time = min(display_time * 10, 1000);
+    if (!this->batch_job)
+        StageProfiler::instance().open(this->profile, this->trace_path);
 
-        // Normal speed
-        else if (keyName == '2')
-            display_time = 1;
+    FramePrefetcher prefetcher(this->prefetch_depth, this->prefetch_threads, this->process_size);
+    prefetcher.set_limit(this->decode_limit);
+    this->open_source(prefetcher);
+    prefetcher.seek(keyframe);
+    prefetcher.start();
 
-        // Speed up
-        else if (keyName == '3')
-            display_time = max((int)(display_time / 10), 1);
+    AsyncFrameWriter frame_writer(this->writer_queue_depth, this->writer_threads);
+    frame_writer.set_limit(this->write_limit);
+    frame_writer.set_params(this->frame_write_params());
 
-        else if (keyName == 'r' || (this->check_use_frame_range("r") && frame_id == this->frame_range[0]))
-        {
-            this->start_mode = "";
-            removeItem = true;
-            if (this->delete_one_class)
+    this->copy_names_file();
+
+    TrackerPool trackers(this->tracker_threads, this->tracker_options);
+
+    FramePacket packet;
+    int frame_id = 0;
+    int propagated = 0;
+    auto start_time = chrono::steady_clock::now();
+
+    while (prefetcher.next(packet))
+    {
+        ScopedStage frame_stage(STAGE_FRAME, packet.frame_id);
+        frame_id = packet.frame_id;
+        this->save_frame(packet, frame_writer);
+
+        if (frame_id < keyframe)
+            continue;
+        if (last_frame != -1 && frame_id > last_frame)
+            break;
+
+        Mat frame = packet.frame;
+        int h = frame.rows;
+        int w = frame.cols;
+        int source_w = packet.source_size.width;
+        int source_h = packet.source_size.height;
+
+        if (frame_id == keyframe)
+        {
+            vector<vector<float>> yolo_points;
+            vector<string> class_names;
+
+            for (Label &seed : seeds)
             {
-                string input_msg = "==================================================";
-                cout << input_msg << endl;
-                this->print_labels();
-                cout << "Input Class Name( delete ): ";
-                getline(cin, choiced_class_name);
+                Rect2i area((int)((seed.cx - seed.w / 2) * w), (int)((seed.cy - seed.h / 2) * h),
+                            (int)(seed.w * w), (int)(seed.h * h));
+                trackers.add(frame, area, this->names[seed.class_id], false);
+
+                yolo_points.push_back({seed.cx, seed.cy, seed.w, seed.h});
+                class_names.push_back(this->names[seed.class_id]);
+            }
+
+            if (this->write_txt && !from_store)
+                this->write_point2txt(yolo_points, class_names, frame_id);
+            continue;
+        }
+
+        {
+            ScopedStage stage(STAGE_TRACKER_UPDATE, frame_id);
+            trackers.update(frame);
+        }
+        trackers.remove_lost(this->max_lost_frames);
+        if (trackers.empty())
+        {
+            cout << "All tracks lost at frame " << frame_id << endl;
+            break;
+        }
+
+        vector<vector<float>> yolo_points;
+        vector<string> class_names;
+
+        for (Track &track : trackers.get_tracks())
+        {
+            if (!track.success)
+                continue;
+
+            Box pointxy = this->to_source_box(track.box, frame.size(), packet.source_size);
+
+            yolo_points.push_back(this->to_yolo_point(pointxy, source_w, source_h));
+            class_names.push_back(track.class_name);
+        }
+
+        if (this->write_txt && !yolo_points.empty())
+        {
+            ScopedStage stage(STAGE_LABEL_WRITE, frame_id);
+            this->write_point2txt(yolo_points, class_names, frame_id);
+        }
+
+        ++propagated;
+        if (propagated % 100 == 0)
+            cout << "Frame " << frame_id << ", tracks: " << trackers.get_tracks().size() << endl;
+    }
+
+    float seconds = chrono::duration<float>(chrono::steady_clock::now() - start_time).count();
+    cout << "Propagated " << propagated << " frames in " << seconds << " s ("
+         << (seconds > 0 ? propagated / seconds : 0) << " fps)" << endl;
+
+    prefetcher.stop();
+    frame_writer.flush();
+    this->annotations.close();
+
+    if (!this->batch_job)
+    {
+        StageProfiler::instance().dump();
+        StageProfiler::instance().close();
+    }
+
+    return;
+}
+
+void SemiAutomaticLabel::run_job(filesystem::path video_path, string task, Semaphore *decode_limit, Semaphore *write_limit)
+{
+    /*
+    One video of a batch: `task` runs headless on `video_path`, the output folder is built like in `start()`.
+    Decoders and writers are throttled by the limits shared by the whole batch, the batch owns the profiler.
+    An error of the video throws `runtime_error` instead of stopping the process, see `fail`.
+    */
+
+    this->video_path = video_path;
+    this->read_from_video = true;
+    this->batch_job = true;
+    this->decode_limit = decode_limit;
+    this->write_limit = write_limit;
+
+    // The jobs already use every core, a job does not start one thread per core on top of it
+    if (this->writer_threads <= 0)
+        this->writer_threads = 1;
+    if (this->tracker_threads <= 0)
+        this->tracker_threads = 1;
+    if (this->render_threads <= 0)
+        this->render_threads = 1;
+
+    if (task == "extract")
+        this->extract_frames();
+    else if (task == "propagate")
+        this->propagate({});
+    else if (task == "interpolate")
+        this->interpolate({});
+    else if (task == "render")
+    {
+        // One fixed `output_path` would be overwritten by every video
+        this->render_path.clear();
+        this->render_video();
+    }
+    else
+    {
+        this->fail("Unknown batch task: " + task + "\nSupport: extract, propagate, interpolate, render");
+    }
+
+    return;
+}
+
+filesystem::path SemiAutomaticLabel::frame_file(int frame_id)
+{
+    stringstream ss;
+    ss << setw(6) << setfill('0') << frame_id;
+
+    return this->out_dir / (ss.str() + "." + this->frame_format);
+}
+
+vector<int> SemiAutomaticLabel::frame_write_params()
+{
+    if (this->frame_format == "jpg")
+        return {IMWRITE_JPEG_QUALITY, this->frame_quality};
+    else if (this->frame_format == "webp")
+        return {IMWRITE_WEBP_QUALITY, max(this->frame_quality, 1)};
+    else if (this->frame_format == "png")
+        return {IMWRITE_PNG_COMPRESSION, this->png_compression};
+
+    this->fail("Unknown frame format: " + this->frame_format + "\nSupport: jpg, png, webp");
+}
+
+void SemiAutomaticLabel::extract_frames()
+{
+    /*
+    Stream the video through the parallel encoder, every `stride`-th frame is saved.
+    Progress is appended to `extract.manifest`, a stopped extraction resumes at the last checkpoint
+    (frames after it are written again) and a finished one is skipped. No frame is checked on disk.
+    */
+
+    this->set_out_dir();
+
+    // `out_dir` not exists
+    if (access(this->out_dir.c_str(), 0))
+        filesystem::create_directories(this->out_dir);
+    cout << "Output Path: " << this->out_dir << endl;
+
+    if (!this->read_from_video)
+    {
+        this->fail("`extract` reads from video, set `read_from_video` to True");
+    }
+
+    vector<int> params = this->frame_write_params();
+
+    ExtractManifest manifest;
+    manifest.begin(this->out_dir / "extract.manifest", this->video_path, this->frame_format, this->frame_quality, this->extract_stride);
+    if (manifest.is_complete())
+    {
+        cout << "Already extracted: " << manifest.last_frame() << " frames of " << this->video_path << endl;
+        return;
+    }
+
+    int start_frame = manifest.last_frame() + 1;
+    if (start_frame > 1)
+        cout << "Resume extraction at frame " << start_frame << endl;
+
+    // No processing resolution: frames are only saved
+    FramePrefetcher prefetcher(this->prefetch_depth, this->prefetch_threads, Size(0, 0));
+    prefetcher.set_limit(this->decode_limit);
+    this->open_source(prefetcher);
+    if (start_frame > 1)
+        prefetcher.seek(start_frame);
+    prefetcher.start();
+
+    AsyncFrameWriter frame_writer(this->writer_queue_depth, this->writer_threads);
+    frame_writer.set_limit(this->write_limit);
+    frame_writer.set_params(params);
+
+    this->copy_names_file();
+
+    FramePacket packet;
+    int last_frame = start_frame - 1;
+    int saved = 0;
+    auto start_time = chrono::steady_clock::now();
+
+    while (prefetcher.next(packet))
+    {
+        ScopedStage frame_stage(STAGE_FRAME, packet.frame_id);
+        last_frame = packet.frame_id;
+
+        if ((last_frame - 1) % this->extract_stride == 0)
+        {
+            frame_writer.write(this->frame_file(last_frame), packet.source);
+            ++saved;
+        }
+
+        // Only a checkpoint waits for the encoders, decoding goes on meanwhile.
+        // A frame that failed to write stops the extraction, the manifest stays on the last checkpoint
+        if (last_frame % this->checkpoint_frames == 0)
+        {
+            if (frame_writer.flush() > 0)
+                this->fail("Fail to write frames before frame " + to_string(last_frame) + ", extraction stopped");
+            manifest.checkpoint(last_frame);
+        }
+    }
+
+    prefetcher.stop();
+    if (frame_writer.flush() > 0)
+        this->fail("Fail to write frames before frame " + to_string(last_frame) + ", extraction stopped");
+    manifest.complete(last_frame);
+
+    float seconds = chrono::duration<float>(chrono::steady_clock::now() - start_time).count();
+    cout << "Extracted " << saved << " frames of " << this->video_path << " in " << seconds << " s ("
+         << (seconds > 0 ? saved / seconds : 0) << " fps)" << endl;
+
+    return;
+}
+
+void SemiAutomaticLabel::render_video()
+{
+    /*
+    Review video of the labels, no window: every frame with its boxes and class names drawn
+    like `load_labeled_data`, encoded with `cv::VideoWriter`.
+    Overlays are drawn on `num_threads` threads, up to `queue_depth` frames in flight,
+    and handed to the encoder in frame order.
+    */
+
+    this->read_labels_file();
+    this->generate_colors();
+    this->set_out_dir();
+
+    if (access(this->out_dir.c_str(), 0))
+    {
+        this->fail("Output Path Not exists, nothing to render: " + this->out_dir.string());
+    }
+    cout << "Output Path: " << this->out_dir << endl;
+
+    // A review never changes the dataset
+    this->outputs.scan(this->out_dir, this->frame_format);
+    this->annotations.set_outputs(&this->outputs);
+    this->annotations.set_read_only(true);
+    this->annotations.open(this->out_dir, this->label_flush_ms, this->label_format);
+
+    this->check_frame_range();
+    int first_frame = this->check_use_frame_range("") ? this->frame_range[0] : 1;
+    int last_frame = this->check_use_frame_range("") ? this->frame_range[1] : -1;
+
+    filesystem::path render_path = this->render_path.empty() ? this->out_dir / "review.mp4" : this->render_path;
+
+    if (!this->batch_job)
+        StageProfiler::instance().open(this->profile, this->trace_path);
+
+    FramePrefetcher prefetcher(this->prefetch_depth, this->prefetch_threads, this->render_size);
+    prefetcher.set_limit(this->decode_limit);
+    this->open_source(prefetcher);
+    prefetcher.seek(first_frame);
+    prefetcher.start();
+
+    double fps = (this->render_fps > 0) ? this->render_fps : prefetcher.fps();
+    if (fps <= 0)
+        fps = 30;
+
+    ThreadPool pool(this->render_threads);
+    VideoWriter writer;
+
+    // Overlay tasks in frame order, the deque keeps every canvas in place while its task runs
+    deque<pair<future<void>, Mat>> in_flight;
+    int rendered = 0;
+    auto start_time = chrono::steady_clock::now();
+
+    auto encode = [&]()
+    {
+        in_flight.front().first.get();
+        Mat &canvas = in_flight.front().second;
+
+        if (!writer.isOpened())
+        {
+            const char *code = this->render_fourcc.c_str();
+            writer.open(render_path, VideoWriter::fourcc(code[0], code[1], code[2], code[3]), fps, canvas.size());
+            if (!writer.isOpened())
+            {
+                // The overlay tasks draw into `in_flight`, it has to outlive them
+                for (auto &task : in_flight)
+                    if (task.first.valid())
+                        task.first.wait();
+                this->fail("Fail to open: " + render_path.string());
+            }
+        }
+
+        {
+            ScopedStage stage(STAGE_ENCODE, -1);
+            writer.write(canvas);
+        }
+        in_flight.pop_front();
+        ++rendered;
+    };
+
+    FramePacket packet;
+    while (prefetcher.next(packet))
+    {
+        int frame_id = packet.frame_id;
+        if (last_frame != -1 && frame_id > last_frame)
+            break;
+        if (this->render_labeled_only && !this->annotations.has(frame_id))
+            continue;
+
+        in_flight.emplace_back();
+        Mat &canvas = in_flight.back().second;
+        Mat frame = packet.frame;
+        in_flight.back().first = pool.submit([this, &canvas, frame, frame_id]()
+                                             {
+                                                 ScopedStage stage(STAGE_DISPLAY, frame_id);
+                                                 canvas = frame.clone();
+                                                 this->load_labeled_data(canvas, frame_id);
+                                                 putText(canvas, to_string(frame_id), Point(70, 50), FONT_HERSHEY_DUPLEX, 1, Scalar(0, 0, 255), 1, LINE_AA);
+                                             });
+
+        if ((int)in_flight.size() >= this->render_queue_depth)
+            encode();
+    }
+    while (!in_flight.empty())
+        encode();
+
+    prefetcher.stop();
+    writer.release();
+    this->annotations.close();
+
+    float seconds = chrono::duration<float>(chrono::steady_clock::now() - start_time).count();
+    cout << "Rendered " << rendered << " frames to " << render_path << " in " << seconds << " s ("
+         << (seconds > 0 ? rendered / seconds : 0) << " fps)" << endl;
+
+    if (!this->batch_job)
+    {
+        StageProfiler::instance().dump();
+        StageProfiler::instance().close();
+    }
+
+    return;
+}
+
+void SemiAutomaticLabel::interpolate_keyframes()
+{
+    /*
+    Fill the frames between labeled keyframes, no tracker and no video needed.
+    Boxes of two consecutive keyframes are paired by class and best IoU, unpaired boxes start or end an object.
+    Keyframes more than `max_keyframe_gap` frames apart are not bridged.
+    Nothing is saved when `write_txt` is False, the filled frames are only counted.
+    */
+
+    int first_frame = this->check_use_frame_range("") ? this->frame_range[0] : 1;
+    int last_frame = this->check_use_frame_range("") ? this->frame_range[1] : -1;
+
+    vector<int> keyframes;
+    for (int frame_id : this->annotations.frame_ids())
+        if (frame_id >= first_frame && (last_frame == -1 || frame_id <= last_frame))
+            keyframes.push_back(frame_id);
+
+    KeyframeInterpolator interpolator(this->interpolate_method);
+
+    auto to_box = [](const Label &label)
+    {
+        return Box({(int)(min(max(label.cx - label.w / 2, 0.0f), 1.0f) * INTERPOLATE_BOX_SCALE),
+                    (int)(min(max(label.cy - label.h / 2, 0.0f), 1.0f) * INTERPOLATE_BOX_SCALE),
+                    (int)(min(max(label.cx + label.w / 2, 0.0f), 1.0f) * INTERPOLATE_BOX_SCALE),
+                    (int)(min(max(label.cy + label.h / 2, 0.0f), 1.0f) * INTERPOLATE_BOX_SCALE)});
+    };
+
+    int next_object = 0;
+    vector<Label> prev_labels;
+    vector<int> prev_objects;
+    int prev_frame = -1;
+
+    for (int frame_id : keyframes)
+    {
+        vector<Label> labels = this->annotations.get(frame_id);
+        vector<int> objects(labels.size(), -1);
+
+        if (prev_frame != -1 && frame_id - prev_frame <= this->max_keyframe_gap)
+        {
+            BoxBatch prev_boxes;
+            for (Label &label : prev_labels)
+                prev_boxes.push_back(to_box(label));
+
+            vector<char> used(prev_labels.size(), 0);
+            vector<float> iou(prev_labels.size());
+            for (size_t i = 0; i < labels.size(); ++i)
+            {
+                prev_boxes.iou(to_box(labels[i]), iou.data());
+
+                int best = -1;
+                for (size_t j = 0; j < prev_labels.size(); ++j)
+                    if (!used[j] && prev_labels[j].class_id == labels[i].class_id && iou[j] > 0 && (best == -1 || iou[j] > iou[best]))
+                        best = j;
+
+                if (best != -1)
+                {
+                    used[best] = 1;
+                    objects[i] = prev_objects[best];
+                }
+            }
+        }
+
+        for (size_t i = 0; i < labels.size(); ++i)
+        {
+            if (objects[i] == -1)
+                objects[i] = next_object++;
+            interpolator.add(objects[i], frame_id, labels[i]);
+        }
+
+        prev_labels = labels;
+        prev_objects = objects;
+        prev_frame = frame_id;
+    }
+
+    map<int, vector<Label>> frames;
+    interpolator.fill(frames, false);
+
+    // Frames of a gap wider than `max_keyframe_gap` belong to no object, so they are never filled
+    if (this->write_txt)
+        for (auto &it : frames)
+            this->annotations.add(it.first, it.second);
+
+    cout << "Interpolated " << frames.size() << " frames between " << keyframes.size() << " keyframes" << endl;
+    if (!this->write_txt)
+        cout << "`write_txt` is False, nothing saved" << endl;
+
+    return;
+}
+
+void SemiAutomaticLabel::interpolate(vector<string> seed_args)
+{
+    /*
+    Headless, like `propagate`, but boxes are only measured on sparse keyframes.
+        "keyframes": the labeled frames are the keyframes, see `interpolate_keyframes`.
+        "tracker":   the seed boxes are tracked from keyframe to keyframe, the tracker only sees
+                     every `stride`-th frame. The stride doubles while the boxes move less than half of
+                     `motion_threshold` and halves (back to the last keyframe) when a track fails or
+                     moves more. The frames in between are interpolated.
+    */
+
+    this->read_labels_file();
+    this->set_out_dir();
+
+    // `out_dir` not exists
+    if (access(this->out_dir.c_str(), 0))
+        filesystem::create_directories(this->out_dir);
+    cout << "Output Path: " << this->out_dir << endl;
+
+    this->outputs.scan(this->out_dir, this->frame_format);
+    this->annotations.set_outputs(&this->outputs);
+    this->annotations.open(this->out_dir, this->label_flush_ms, this->label_format);
+    this->check_frame_range();
+
+    if (this->interpolate_source == "keyframes")
+    {
+        this->interpolate_keyframes();
+        this->annotations.close();
+        return;
+    }
+    else if (this->interpolate_source != "tracker")
+    {
+        this->fail("Unknown interpolate source: " + this->interpolate_source + "\nSupport: tracker, keyframes");
+    }
+
+    int keyframe = this->check_use_frame_range("") ? this->frame_range[0] : 1;
+    int last_frame = this->check_use_frame_range("") ? this->frame_range[1] : -1;
+
+    bool from_store;
+    vector<Label> seeds = this->load_seeds(keyframe, seed_args, from_store);
+    if (seeds.empty())
+    {
+        this->fail("No seed boxes for keyframe " + to_string(keyframe));
+    }
+    cout << "Interpolate " << seeds.size() << " seed boxes from frame " << keyframe << endl;
+
+    if (!this->batch_job)
+        StageProfiler::instance().open(this->profile, this->trace_path);
+
+    FramePrefetcher prefetcher(this->prefetch_depth, this->prefetch_threads, this->process_size);
+    prefetcher.set_limit(this->decode_limit);
+    this->open_source(prefetcher);
+    prefetcher.seek(keyframe);
+    prefetcher.start();
+
+    AsyncFrameWriter frame_writer(this->writer_queue_depth, this->writer_threads);
+    frame_writer.set_limit(this->write_limit);
+    frame_writer.set_params(this->frame_write_params());
+
+    this->copy_names_file();
+
+    TrackerPool trackers(this->tracker_threads, this->tracker_options);
+    KeyframeInterpolator interpolator(this->interpolate_method);
+
+    // Frames since the last keyframe, `window[0]` is the last keyframe
+    vector<FramePacket> window;
+    FramePacket packet;
+    while (prefetcher.next(packet))
+    {
+        this->save_frame(packet, frame_writer);
+        if (packet.frame_id == keyframe)
+        {
+            window.push_back(packet);
+            break;
+        }
+    }
+    if (window.empty())
+    {
+        this->fail("Keyframe " + to_string(keyframe) + " not found");
+    }
+
+    // Objects still tracked, with their box on `window[0]`
+    vector<int> objects;
+    vector<Label> boxes = seeds;
+    map<int, int> object_of_track;
+
+    auto init_tracks = [&]()
+    {
+        Mat frame = window[0].frame;
+        int w = frame.cols;
+        int h = frame.rows;
+
+        trackers.clear();
+        object_of_track.clear();
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            Label &box = boxes[i];
+            Rect2i area((int)((box.cx - box.w / 2) * w), (int)((box.cy - box.h / 2) * h), (int)(box.w * w), (int)(box.h * h));
+            object_of_track[trackers.add(frame, area, this->names[box.class_id], false)] = i;
+        }
+    };
+
+    for (size_t i = 0; i < seeds.size(); ++i)
+    {
+        objects.push_back(i);
+        interpolator.add(i, keyframe, seeds[i]);
+    }
+    init_tracks();
+
+    int stride = this->min_stride;
+    int tracker_updates = 0;
+    bool source_end = false;
+    auto start_time = chrono::steady_clock::now();
+
+    while (!objects.empty())
+    {
+        while ((int)window.size() <= stride && !source_end)
+        {
+            if (!prefetcher.next(packet) || (last_frame != -1 && packet.frame_id > last_frame))
+            {
+                source_end = true;
+                break;
+            }
+            this->save_frame(packet, frame_writer);
+            window.push_back(packet);
+        }
+        if (window.size() == 1)
+            break;
+
+        int target = min(stride, (int)window.size() - 1);
+        FramePacket &next = window[target];
+
+        {
+            ScopedStage stage(STAGE_TRACKER_UPDATE, next.frame_id);
+            trackers.update(next.frame);
+        }
+        ++tracker_updates;
+
+        // Drift check: a failed track or a box that moved too far for the stride
+        vector<Label> next_boxes(objects.size());
+        vector<char> failed(objects.size(), 0);
+        float motion = 0;
+        for (Track &track : trackers.get_tracks())
+        {
+            int i = object_of_track[track.id];
+            if (!track.success)
+            {
+                failed[i] = 1;
+                continue;
+            }
+
+            Box pointxy = this->to_source_box(track.box, next.frame.size(), next.source_size);
+            vector<float> yolo_point = this->to_yolo_point(pointxy, next.source_size.width, next.source_size.height);
+            next_boxes[i] = Label({boxes[i].class_id, yolo_point[0], yolo_point[1], yolo_point[2], yolo_point[3]});
+
+            float size = sqrt(max(boxes[i].w * boxes[i].h, 1e-6f));
+            float shift = hypot(next_boxes[i].cx - boxes[i].cx, next_boxes[i].cy - boxes[i].cy) / size;
+            float scale = fabs(log(max(next_boxes[i].w * next_boxes[i].h, 1e-6f) / (size * size))) / 2;
+            motion = max(motion, shift + scale);
+        }
+
+        bool any_failed = find(failed.begin(), failed.end(), 1) != failed.end();
+        if ((any_failed || motion > this->motion_threshold) && target > this->min_stride)
+        {
+            stride = max(target / 2, this->min_stride);
+            init_tracks();
+            continue;
+        }
+
+        // Keyframe accepted, objects lost even at the smallest stride end here
+        vector<int> kept_objects;
+        vector<Label> kept_boxes;
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            if (failed[i])
+                continue;
+            interpolator.add(objects[i], next.frame_id, next_boxes[i]);
+            kept_objects.push_back(objects[i]);
+            kept_boxes.push_back(next_boxes[i]);
+        }
+        bool lost = kept_objects.size() != objects.size();
+        objects = kept_objects;
+        boxes = kept_boxes;
+
+        window.erase(window.begin(), window.begin() + target);
+        if (lost)
+            init_tracks();
+
+        if (!any_failed && motion < this->motion_threshold / 2)
+            stride = min(stride * 2, this->max_stride);
+
+        if (window[0].frame_id / 100 != (window[0].frame_id - target) / 100)
+            cout << "Frame " << window[0].frame_id << ", stride: " << stride << ", tracks: " << objects.size() << endl;
+    }
+
+    if (objects.empty())
+        cout << "All tracks lost at frame " << window[0].frame_id << endl;
+
+    map<int, vector<Label>> frames;
+    interpolator.fill(frames, true);
+    if (from_store)
+        frames.erase(keyframe);
+
+    if (this->write_txt)
+    {
+        for (auto &it : frames)
+            this->annotations.add(it.first, it.second);
+    }
+
+    float seconds = chrono::duration<float>(chrono::steady_clock::now() - start_time).count();
+    cout << "Labeled " << frames.size() << " frames with " << tracker_updates << " tracker updates ("
+         << interpolator.keyframe_count() << " keyframe boxes) in " << seconds << " s" << endl;
+
+    prefetcher.stop();
+    frame_writer.flush();
+    this->annotations.close();
+
+    if (!this->batch_job)
+    {
+        StageProfiler::instance().dump();
+        StageProfiler::instance().close();
+    }
+
+    return;
+}
+
+string SemiAutomaticLabel::input_class_name(string prompt)
+{
+    /*
+    Ask for a class name on the console until it is one of `names`.
+    */
 
-                choiced_class_name = this->remove_space(choiced_class_name);
+    string choiced_class_name;
+    string input_msg = "==================================================";
+    cout << input_msg << endl;
+    this->print_labels();
+    cout << prompt;
+    getline(cin, choiced_class_name);
 
-                while (find(this->names.begin(), this->names.end(), choiced_class_name) == this->names.end())
-                {
-                    cout << choiced_class_name << " not in names please input again" << endl;
-                    cout << input_msg << endl;
-                    this->print_labels();
-                    cout << "Input Class Name( delete ): ";
-                    getline(cin, choiced_class_name);
+    choiced_class_name = this->remove_space(choiced_class_name);
 
-                    choiced_class_name = this->remove_space(choiced_class_name);
-                }
+    while (find(this->names.begin(), this->names.end(), choiced_class_name) == this->names.end())
+    {
+        cout << choiced_class_name << " not in names please input again" << endl;
+        cout << input_msg << endl;
+        this->print_labels();
+        cout << prompt;
+        getline(cin, choiced_class_name);
+
+        choiced_class_name = this->remove_space(choiced_class_name);
+    }
+
+    return choiced_class_name;
+}
+
+void SemiAutomaticLabel::save_frame(FramePacket &packet, AsyncFrameWriter &frame_writer)
+{
+    /*
+    First run on a video: extract the frame next to the labels.
+    */
+
+    if (!this->read_from_video || packet.source.empty())
+        return;
+
+    // Frames the extract manifest has on disk are not checked one by one
+    if (packet.frame_id <= this->extracted_until)
+        return;
+
+    // Existence comes from the snapshot of `out_dir`, the frame is recorded as soon as it is queued
+    if (this->outputs.has_frame(packet.frame_id))
+        return;
+
+    frame_writer.write(this->frame_file(packet.frame_id), packet.source);
+    this->outputs.add_frame(packet.frame_id);
+
+    return;
+}
+
+bool SemiAutomaticLabel::fetch_frame(int frame_id, FramePrefetcher &prefetcher, AsyncFrameWriter &frame_writer, FrameCache &cache, FramePacket &packet)
+{
+    /*
+    Frame `frame_id` (0: the next frame of the source) from, in order:
+        the cache of recent frames,
+        the prefetcher, when it is ahead of the source position (every frame on the way is cached),
+        the saved image, when it is behind and no longer cached.
+    */
+
+    if (frame_id > 0 && cache.get(frame_id, packet))
+        return true;
+
+    if (frame_id == 0 || frame_id >= prefetcher.next_frame_id())
+    {
+        while (prefetcher.next(packet))
+        {
+            this->save_frame(packet, frame_writer);
+            cache.put(packet);
+
+            if (frame_id == 0 || packet.frame_id == frame_id)
+                return true;
+        }
+        return false;
+    }
+
+    filesystem::path img_path = prefetcher.frame_path(frame_id);
+    if (this->read_from_video)
+    {
+        img_path = this->frame_file(frame_id);
+        if (!this->outputs.has_frame(frame_id))
+        {
+            cout << "Not extracted: " << img_path << endl;
+            return false;
+        }
+        frame_writer.flush();
+    }
+
+    Mat source = imread(img_path);
+    if (source.empty())
+    {
+        cout << "Fail to read: " << img_path << endl;
+        return false;
+    }
+
+    packet = FramePacket();
+    packet.frame_id = frame_id;
+    packet.source_size = source.size();
+    if (this->process_size.area() <= 0 || this->process_size == packet.source_size)
+        packet.frame = source;
+    else
+        resize(source, packet.frame, this->process_size);
+    cache.put(packet);
+
+    return true;
+}
+
+Box SemiAutomaticLabel::to_source_box(Rect2i box, Size frame_size, Size source_size)
+{
+    /*
+    Box of the working frame to [xmin, ymin, xmax, ymax] in the source resolution, clipped.
+    */
+
+    float sx = (float)source_size.width / frame_size.width;
+    float sy = (float)source_size.height / frame_size.height;
+
+    Box pointxy = this->point2xyminmax(box);
+    pointxy.xmin = (int)(pointxy.xmin * sx);
+    pointxy.ymin = (int)(pointxy.ymin * sy);
+    pointxy.xmax = (int)(pointxy.xmax * sx);
+    pointxy.ymax = (int)(pointxy.ymax * sy);
+
+    return box_clip(pointxy, source_size.width, source_size.height);
+}
+
+Mat SemiAutomaticLabel::render_display(Mat frame, int frame_id)
+{
+    /*
+    Display buffer of `frame` at `display_size` with the saved labels drawn on it.
+    The working frame itself stays clean for the trackers.
+    */
+
+    Mat display;
+    if (frame.size() == this->display_size)
+        display = frame.clone();
+    else
+        resize(frame, display, this->display_size);
+
+    if (this->annotations.has(frame_id))
+    {
+        ScopedStage stage(STAGE_LABEL_LOAD, frame_id);
+        this->load_labeled_data(display, frame_id);
+    }
+
+    return display;
+}
+
+Rect2i SemiAutomaticLabel::select_box(Mat display, Mat frame)
+{
+    /*
+    Box drawn on the display buffer, scaled to the working frame.
+    */
+
+    Rect2d area = selectROI(this->video_path, display, false, false);
+
+    float sx = (float)frame.cols / display.cols;
+    float sy = (float)frame.rows / display.rows;
+
+    return Rect2i((int)(area.x * sx), (int)(area.y * sy), (int)(area.width * sx), (int)(area.height * sy));
+}
+
+void SemiAutomaticLabel::apply_tracks(TrackerPool &trackers, Mat display, FramePacket &packet, int only_track_id)
+{
+    /*
+    Save (or delete with) the current box of every successful track on `packet` and draw it on `display`.
+    Boxes are mapped to the source resolution first, `display` is empty when nothing is shown.
+    `only_track_id >= 0` applies a single track, used right after it is created.
+    Each track's boxes go into its own undo action, undoing one track leaves the others.
+    A track back on a frame it already saved (after stepping back) replaces its old box there.
+    */
+
+    int frame_id = packet.frame_id;
+    int w = packet.source_size.width;
+    int h = packet.source_size.height;
+
+    vector<vector<float>> yolo_points;
+    vector<vector<float>> replaced_points; // Box the track saved on the frame before, empty for none
+    vector<string> class_names;
+    vector<int> point_actions;
+    vector<Box> delete_boxes;
+    vector<string> delete_class_names;
+    vector<int> delete_actions;
+
+    for (Track &track : trackers.get_tracks())
+    {
+        if (only_track_id >= 0 ? track.id != only_track_id : !track.success)
+            continue;
+
+        Box pointxy = this->to_source_box(track.box, packet.frame.size(), packet.source_size);
+
+        auto written = track.written.find(frame_id);
+        vector<float> replaced;
+        if (written != track.written.end())
+            replaced = this->to_yolo_point(this->to_source_box(written->second, packet.frame.size(), packet.source_size), w, h);
+        track.written[frame_id] = track.box;
+
+        if (track.remove_item)
+        {
+            delete_boxes.push_back(pointxy);
+            delete_class_names.push_back(track.class_name);
+            delete_actions.push_back(track.action);
+        }
+        else
+        {
+            yolo_points.push_back(this->to_yolo_point(pointxy, w, h));
+            replaced_points.push_back(replaced);
+            class_names.push_back(track.class_name);
+            point_actions.push_back(track.action);
+        }
+
+        if (display.empty())
+            continue;
+
+        float sx = (float)display.cols / w;
+        float sy = (float)display.rows / h;
+        Point top_left((int)(pointxy.xmin * sx), (int)(pointxy.ymin * sy));
+        Point bottom_right((int)(pointxy.xmax * sx), (int)(pointxy.ymax * sy));
+
+        rectangle(display, top_left, bottom_right,
+                  Scalar(0, 0, 255),
+                  3);
+
+        string plot_msg = (!track.remove_item) ? track.class_name : (this->delete_one_class) ? "Delete(" + track.class_name + ")"
+                                                                                             : "Delete";
+        putText(display, plot_msg + " #" + to_string(track.id), Point(top_left.x, top_left.y - 10), FONT_HERSHEY_DUPLEX, 1,
+                Scalar(0, 0, 255),
+                1, LINE_AA);
+    }
+
+    if (!delete_boxes.empty() && this->annotations.has(frame_id))
+    {
+        ScopedStage stage(STAGE_LABEL_WRITE, frame_id);
+        this->remove_labeled_data(frame_id, delete_boxes, delete_class_names, w, h, delete_actions);
+    }
+
+    if (this->write_txt && !yolo_points.empty())
+    {
+        ScopedStage stage(STAGE_LABEL_WRITE, frame_id);
+        for (size_t i = 0; i < yolo_points.size(); ++i)
+        {
+            if (replaced_points[i].empty())
+                this->write_point2txt({yolo_points[i]}, {class_names[i]}, frame_id, point_actions[i]);
+            else
+                this->replace_point(frame_id, replaced_points[i], yolo_points[i], class_names[i], point_actions[i]);
+        }
+    }
+
+    return;
+}
+
+void SemiAutomaticLabel::start()
+{
+    if (!this->batch_job)
+        StageProfiler::instance().open(this->profile, this->trace_path);
+    TrackerPool trackers(this->tracker_threads, this->tracker_options);
+
+    this->read_labels_file();
+    string choiced_class_name = "";
+
+    this->generate_colors();
+
+    this->set_out_dir();
+
+    // `out_dir` not exists
+    if (access(this->out_dir.c_str(), 0))
+    {
+        this->show_video = false;
+        this->get_frame_range = false;
+        cout << "First time will create folder and catch every frame" << endl
+             << "Set:" << endl
+             << "\tshow_vid: " << (this->show_video ? "True" : "False") << endl
+             << "\tget_frame_range: " << (this->get_frame_range ? "True" : "False") << endl;
+        filesystem::create_directories(this->out_dir);
+    }
+
+    cout << "Output Path: " << this->out_dir << endl;
+
+    this->outputs.scan(this->out_dir, this->frame_format);
+    this->annotations.set_outputs(&this->outputs);
+
+    if (this->remove_json)
+        this->remove_json_file();
+    this->annotations.set_undo_limit(this->undo_actions);
+    this->annotations.open(this->out_dir, this->label_flush_ms, this->label_format);
+
+    this->check_frame_range();
+
+    // Detector proposals are inferred on their own thread, on frames the prefetcher has ready
+    unique_ptr<DetectionProposer> proposer;
+    if (this->proposer_options.enable)
+    {
+        proposer = make_unique<DetectionProposer>(this->proposer_options, this->proposer_class_map());
+        proposer->start();
+    }
+
+    FramePrefetcher prefetcher(this->prefetch_depth, this->prefetch_threads, this->process_size);
+    this->open_source(prefetcher);
+    if (this->check_use_frame_range(""))
+        prefetcher.seek(this->frame_range[0] - 1);
+    if (proposer)
+    {
+        proposer->set_cursor(this->check_use_frame_range("") ? this->frame_range[0] - 1 : 1);
+        prefetcher.set_observer([&proposer](const FramePacket &packet)
+                                { proposer->push(packet); });
+    }
+    prefetcher.start();
+
+    AsyncFrameWriter frame_writer(this->writer_queue_depth, this->writer_threads);
+    frame_writer.set_params(this->frame_write_params());
+
+    this->copy_names_file();
+
+    FrameCache cache(this->frame_cache_mb);
+
+    // Playback at the source frame rate x speed, frames are still tracked and saved when their display is dropped
+    FramePacer pacer((this->playback_fps > 0) ? this->playback_fps : prefetcher.fps());
+    bool shown = false;
+
+    vector<Label> proposals;
+    bool proposals_ready = false;
+
+    int frame_id = 0;
+    int prev_frame_id = 0;
+    int next_frame_id = 0; // 0: next frame of the source
+    bool paused = false;
+
+    // Step back / forward can not leave `frame_range`
+    int first_frame = this->check_use_frame_range("") ? this->frame_range[0] - 1 : 1;
+    int last_frame = this->check_use_frame_range("") ? this->frame_range[1] : -1;
+
+    FramePacket packet;
+    Mat frame, display;
+    int keyName;
+
+    while (true)
+    {
+        if (!this->fetch_frame(next_frame_id, prefetcher, frame_writer, cache, packet))
+        {
+            cout << (this->read_from_video ? "End video" : "End frames") << endl;
+            break;
+        }
+        ScopedStage frame_stage(STAGE_FRAME, packet.frame_id);
+        frame_id = packet.frame_id;
+        frame = packet.frame;
+        next_frame_id = frame_id + 1;
+
+        if (this->check_use_frame_range(""))
+        {
+            if (frame_id == this->frame_range[0] - 1)
+                paused = true;
+            else if (frame_id < this->frame_range[0])
+                continue;
+            else if (this->frame_range[1] != -1 && frame_id > this->frame_range[1])
+                break;
+        }
+
+        // Tracks only follow consecutive frames, not a frame shown again while paused
+        bool advanced = frame_id == prev_frame_id + 1;
+        bool jumped = !advanced && frame_id != prev_frame_id;
+        prev_frame_id = frame_id;
+
+        // Stepped or scrubbed: every track restarts from the box it saved on this frame (the frame comes from the cache)
+        if (jumped && !trackers.empty())
+        {
+            int dropped = trackers.rewind(frame, frame_id);
+            if (dropped > 0)
+                cout << "Stop " << dropped << " tracks without a box on frame " << frame_id << endl;
+        }
+
+        // Only playback is paced, a paused frame or a jump starts a new schedule.
+        // Nothing is shown without a window: frames run as fast as they come, none counts as dropped
+        if (this->show_video)
+        {
+            if (paused || !advanced)
+                pacer.reset();
+            pacer.begin_frame();
+        }
+        shown = this->show_video && (paused || pacer.should_display());
+
+        // Frames from the cache or the disk did not go through the prefetcher
+        if (proposer)
+        {
+            proposer->set_cursor(frame_id);
+            proposer->push(packet);
+            proposals_ready = proposer->get(frame_id, proposals);
+        }
+
+        // `frame` stays clean (trackers, cache), overlays only go to the display buffer
+        display = shown ? this->render_display(frame, frame_id) : Mat();
+
+        if (!trackers.empty() && advanced)
+        {
+            {
+                ScopedStage stage(STAGE_TRACKER_UPDATE, frame_id);
+                trackers.update(frame);
+            }
+            this->apply_tracks(trackers, display, packet);
+        }
+
+        if (shown)
+        {
+            ScopedStage stage(STAGE_DISPLAY, frame_id);
+            putText(display, to_string(frame_id), Point(70, 50), FONT_HERSHEY_DUPLEX, 1, Scalar(0, 0, 255), 1, LINE_AA);
+            putText(display, format("Queue: %d/%d  Cache: %d", prefetcher.occupancy(), prefetcher.capacity(), cache.size()), Point(70, 90), FONT_HERSHEY_DUPLEX, 0.6, Scalar(0, 0, 255), 1, LINE_AA);
+            if (paused)
+                putText(display, "Paused", Point(70, 120), FONT_HERSHEY_DUPLEX, 0.6, Scalar(0, 0, 255), 1, LINE_AA);
+            if (proposer)
+            {
+                if (proposals_ready)
+                    this->draw_proposals(display, proposals);
+                putText(display, proposals_ready ? format("Proposals: %d", (int)proposals.size()) : format("Proposals: pending (%d queued)", proposer->pending()),
+                        Point(70, 150), FONT_HERSHEY_DUPLEX, 0.6, Scalar(0, 0, 255), 1, LINE_AA);
             }
+            putText(display, format("FPS: %.1f / %.1f (x%g)  Frame: %.1f ms  Dropped: %d", pacer.achieved_fps(), pacer.target_fps(), pacer.speed(), pacer.processing_ms(), pacer.dropped()),
+                    Point(70, 180), FONT_HERSHEY_DUPLEX, 0.6, Scalar(0, 0, 255), 1, LINE_AA);
+
+            imshow(this->video_path, display);
+        }
+
+        if (this->check_use_frame_range(" ") && frame_id == this->frame_range[0])
+        {
+            this->start_mode = "";
+            paused = true;
+        }
+
+        // Paused on a frame still being inferred: poll, so the proposals show up when they are ready
+        // Playing: wait for the deadline of the frame, a dropped frame does not wait (keys are read on the next shown one)
+        int wait = this->show_video ? pacer.end_frame(shown) : 0;
+
+        // The frame ends here, the key wait and the console input are the user's time
+        frame_stage.stop();
+
+        if (paused && this->show_video)
+            keyName = waitKey((proposer && !proposals_ready) ? 30 : 0);
+        else if (shown)
+            keyName = waitKey(wait);
+        else
+            keyName = -1;
+
+        // Paused: stay on this frame until a key moves (no window, nothing to wait for)
+        if (paused && this->show_video)
+            next_frame_id = frame_id;
+
+        // Exit
+        if (keyName == 'q')
+            break;
+
+        // Pause / resume video
+        else if (keyName == ' ')
+        {
+            paused = !paused;
+            next_frame_id = paused ? frame_id : frame_id + 1;
+        }
+
+        // Step back / forward, scrub back / forward
+        else if (keyName == ',' || keyName == '.' || keyName == '[' || keyName == ']')
+        {
+            int step = (keyName == ',') ? -1 : (keyName == '.') ? 1 : (keyName == '[') ? -this->scrub_step : this->scrub_step;
+
+            next_frame_id = max(frame_id + step, first_frame);
+            if (last_frame != -1)
+                next_frame_id = min(next_frame_id, last_frame);
+            paused = true;
 
-            auto area = selectROI(this->video_path, frame, false, false);
-            tracker = TrackerCSRT::create();
-            tracker->init(frame, area);
-            tracking = true;
         }
 
-        if (tracking)
+        // Draw 1 box
+        else if (keyName == 'a' || (this->check_use_frame_range("a") && frame_id == this->frame_range[0]))
         {
-            Rect2i point;
-            bool success = tracker->update(frame, point);
-            if (success)
+            this->start_mode = "";
+            int action = this->annotations.begin_action();
+            choiced_class_name = this->input_class_name("Input Class Name: ");
+
+            if (display.empty())
+                display = this->render_display(frame, frame_id);
+            Rect2i area = this->select_box(display, frame);
+            int track_id = trackers.add(frame, area, choiced_class_name, false, action);
+            if (track_id >= 0)
             {
-                vector<int> pointxy = this->point2xyminmax(point);
-                pointxy = this->clip(pointxy, w, h);
+                cout << "Start track #" << track_id << ": " << choiced_class_name << endl;
+                this->apply_tracks(trackers, display, packet, track_id);
+            }
+        }
 
-                // Exists
-                if (removeItem && !access(save_txt_path.c_str(), 0))
-                    this->remove_labeled_data(save_txt_path, pointxy, choiced_class_name, w, h);
+        // Cancel tracking
+        else if (keyName == 'c')
+            trackers.clear();
 
-                vector<float> yolo_point = this->to_yolo_point(pointxy, true, w, h);
+        // Accept the proposals of this frame as labels
+        else if (keyName == 'p' && proposer)
+        {
+            if (!proposals_ready)
+                cout << "Proposals of frame " << frame_id << " not ready" << endl;
+            else
+            {
+                this->annotations.add(frame_id, proposals, this->annotations.begin_action());
+                cout << "Accept " << proposals.size() << " proposals of frame " << frame_id << endl;
+            }
+        }
 
-                rectangle(frame, Point(pointxy[0], pointxy[1]), Point(pointxy[2], pointxy[3]),
-                          Scalar(0, 0, 255),
-                          3);
+        // Hand the proposals of this frame to the tracker as seeds
+        else if (keyName == 't' && proposer)
+        {
+            if (!proposals_ready)
+                cout << "Proposals of frame " << frame_id << " not ready" << endl;
+            else
+            {
+                if (display.empty())
+                    display = this->render_display(frame, frame_id);
 
-                string plot_msg = (!removeItem) ? choiced_class_name : (this->delete_one_class) ? "Delete(" + choiced_class_name + ")"
-                                                                                                : "Delete";
-                putText(frame, plot_msg, Point(pointxy[0], pointxy[1] - 10), FONT_HERSHEY_DUPLEX, 1,
-                        Scalar(0, 0, 255),
-                        1, LINE_AA);
+                // One undo action per seeded track
+                for (const Label &label : proposals)
+                {
+                    Rect2i area((int)((label.cx - label.w / 2) * frame.cols), (int)((label.cy - label.h / 2) * frame.rows),
+                                (int)(label.w * frame.cols), (int)(label.h * frame.rows));
+                    int track_id = trackers.add(frame, area, this->names[label.class_id], false, this->annotations.begin_action());
+                    if (track_id >= 0)
+                    {
+                        cout << "Start track #" << track_id << ": " << this->names[label.class_id] << endl;
+                        this->apply_tracks(trackers, display, packet, track_id);
+                    }
+                }
+            }
+        }
 
-                if (this->write_txt && !removeItem)
-                    this->write_point2txt(yolo_point, choiced_class_name, save_txt_path);
+        // Undo / redo the last action: one track's boxes over every frame it followed, accepted proposals
+        else if (keyName == 'z' || keyName == 'y')
+        {
+            int action;
+            int edited_frame = (keyName == 'z') ? this->annotations.undo(action) : this->annotations.redo(action);
+            if (edited_frame < 0)
+                cout << "Nothing to " << (keyName == 'z' ? "undo" : "redo") << endl;
+            else
+            {
+                cout << (keyName == 'z' ? "Undo" : "Redo") << " action #" << action << " from frame " << edited_frame << endl;
+
+                // Only the track that owns the reverted boxes stops, it would write them again
+                if (keyName == 'z')
+                    for (const Track &track : trackers.get_tracks())
+                        if (track.action == action)
+                        {
+                            cout << "Stop track #" << track.id << endl;
+                            trackers.remove(track.id);
+                            break;
+                        }
+
+                // Stay on this frame so the other tracks keep following consecutive frames
+                next_frame_id = frame_id;
+                paused = true;
             }
         }
 
-        if (this->show_video)
+        // Half speed
+        else if (keyName == '1')
+            pacer.set_speed(pacer.speed() / 2);
+
+        // Source frame rate
+        else if (keyName == '2')
+            pacer.set_speed(1);
+
+        // Double speed
+        else if (keyName == '3')
+            pacer.set_speed(pacer.speed() * 2);
+
+        else if (keyName == 'r' || (this->check_use_frame_range("r") && frame_id == this->frame_range[0]))
         {
-            imshow(this->video_path, frame);
-            if (this->check_use_frame_range(" ") && frame_id == this->frame_range[0])
+            this->start_mode = "";
+            int action = this->annotations.begin_action();
+            if (this->delete_one_class)
+                choiced_class_name = this->input_class_name("Input Class Name( delete ): ");
+
+            if (display.empty())
+                display = this->render_display(frame, frame_id);
+            Rect2i area = this->select_box(display, frame);
+            int track_id = trackers.add(frame, area, choiced_class_name, true, action);
+            if (track_id >= 0)
             {
-                this->start_mode = "";
-                waitKey(0);
+                cout << "Start delete track #" << track_id << endl;
+                this->apply_tracks(trackers, display, packet, track_id);
             }
         }
     }
-    if (this->read_from_video)
-        cap.release();
+    prefetcher.stop();
+    if (proposer)
+        proposer->stop();
+
+    cout << "Flush " << frame_writer.pending() << " frames" << endl;
+    frame_writer.flush();
+
+    cout << "Flush labels of " << this->annotations.dirty_count() << " frames" << endl;
+    this->annotations.close();
+
+    if (!this->batch_job)
+    {
+        StageProfiler::instance().dump();
+        StageProfiler::instance().close();
+    }
+
     destroyAllWindows();
 }
 
-int main()
+void SemiAutomaticLabel::export_txt()
 {
-    SemiAutomaticLabel tool;
-    tool.start();
+    /*
+    Export the label pack of the video to the per-frame YOLO txt layout, next to the frames.
+    */
 
-    return 0;
-}
\ No newline at end of file
+    this->set_out_dir();
+
+    LabelPack pack;
+    if (!pack.open(this->out_dir / "labels.pack"))
+        this->fail("Label pack Not exists: " + (this->out_dir / "labels.pack").string());
+    pack.export_txt(this->out_dir);
+    pack.close();
+
+    return;
+}
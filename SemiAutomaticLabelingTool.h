@@ -8,12 +8,37 @@
 #include <opencv2/core/types.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "AnnotationStore.h"
+#include "OutputManifest.h"
+#include "FramePrefetcher.h"
+#include "TrackerPool.h"
+#include "DetectionProposer.h"
+#include "AsyncFrameWriter.h"
+#include "FrameCache.h"
+#include "BoxGeometry.h"
+#include "Semaphore.h"
+
 class SemiAutomaticLabel
 {
 public:
     SemiAutomaticLabel();
+    SemiAutomaticLabel(std::string cfg_file);
     ~SemiAutomaticLabel();
     void start();
+    void export_txt();
+    void propagate(std::vector<std::string> seed_args);
+    void interpolate(std::vector<std::string> seed_args);
+    void extract_frames();
+    void render_video();
+    void run_job(std::filesystem::path video_path, std::string task, Semaphore *decode_limit, Semaphore *write_limit);
+
+protected:
+    // Hot paths, measured by `labeling_bench` through a subclass
+    void generate_colors();
+    void load_labeled_data(cv::Mat frame, int frame_id);
+    void remove_labeled_data(int frame_id, std::vector<Box> delete_boxes, std::vector<std::string> class_names, int w, int h, std::vector<int> actions = {});
+    std::vector<float> to_yolo_point(Box p, int w, int h);
+    void write_point2txt(std::vector<std::vector<float>> yolo_points, std::vector<std::string> class_names, int frame_id, int action = -1);
 
 private:
     void read_cfg_file(std::string cfg_file);
@@ -21,41 +46,103 @@ private:
     void read_labels_file();
     void print_labels();
     void remove_json_file();
+    void set_out_dir();
+    [[noreturn]] void fail(std::string message);
+    void check_frame_range();
+    void open_source(FramePrefetcher &prefetcher);
+    void copy_names_file();
+    std::vector<Label> load_seeds(int keyframe, std::vector<std::string> seed_args, bool &from_store);
+    std::filesystem::path frame_file(int frame_id);
+    std::vector<int> frame_write_params();
+    void interpolate_keyframes();
+    std::string input_class_name(std::string prompt);
+    void save_frame(FramePacket &packet, AsyncFrameWriter &frame_writer);
+    bool fetch_frame(int frame_id, FramePrefetcher &prefetcher, AsyncFrameWriter &frame_writer, FrameCache &cache, FramePacket &packet);
+    Box to_source_box(cv::Rect2i box, cv::Size frame_size, cv::Size source_size);
+    cv::Mat render_display(cv::Mat frame, int frame_id);
+    cv::Rect2i select_box(cv::Mat display, cv::Mat frame);
+    void apply_tracks(TrackerPool &trackers, cv::Mat display, FramePacket &packet, int only_track_id = -1);
     bool check_use_frame_range(std::string mode);
-    void generate_colors();
-    void load_labeled_data(cv::Mat frame, std::filesystem::path save_txt_path);
+    std::vector<int> proposer_class_map();
+    void draw_proposals(cv::Mat display, const std::vector<Label> &proposals);
     std::string remove_space(std::string line);
-    std::vector<int> point2xyminmax(cv::Rect2i p);
-    std::vector<int> point2xyminmax(std::vector<int> p);
-    std::vector<int> clip(std::vector<int> p, int w, int h);
-    void remove_labeled_data(std::filesystem::path save_txt_path, std::vector<int> pointxy, std::string choiced_class_name, int w, int h);
-
-    float compute_iou(std::vector<int> box1, std::vector<int> box2);
-    int compute_overlap(std::vector<int> box1, std::vector<int> box2);
-    int compute_area(std::vector<int> box);
-
-    std::vector<float> to_yolo_point(std::vector<int> p, bool from_xyminmax, int w, int h);
-    void write_point2txt(std::vector<float> yolo_point, std::string choiced_class_name, std::filesystem::path save_txt_path);
+    Box point2xyminmax(cv::Rect2i p);
+    void replace_point(int frame_id, std::vector<float> old_point, std::vector<float> yolo_point, std::string class_name, int action);
 
 private:
-    std::filesystem::path out_dir;
     std::filesystem::path video_path;
     std::filesystem::path labels_file;
 
     bool read_from_video;
     std::filesystem::path frame_dir_path;
+    cv::Size process_size;
+    cv::Size display_size;
 
     bool write_txt;
     bool remove_json;
     bool show_video;
     bool delete_one_class;
+    std::string label_format;
+    int undo_actions;
+
+    std::string frame_format;
+    int frame_quality;
+    int png_compression;
+    int extract_stride;
+    int checkpoint_frames;
+    int extracted_until; // Frames on disk according to `extract.manifest`
 
     bool get_frame_range;
     std::vector<int> frame_range;
     std::string start_mode;
+    int scrub_step;
+    double playback_fps;
+
+    int tracker_threads;
+    TrackerOptions tracker_options;
 
+    std::filesystem::path seed_file;
+    std::vector<std::pair<std::string, std::vector<float>>> seed_boxes;
+    int max_lost_frames;
+
+    std::string interpolate_source;
+    std::string interpolate_method;
+    int min_stride;
+    int max_stride;
+    int max_keyframe_gap; // "keyframes": labeled frames farther apart are not bridged
+    float motion_threshold;
+
+    ProposerOptions proposer_options;
+
+    std::filesystem::path render_path;
+    std::string render_fourcc;
+    double render_fps;
+    cv::Size render_size;
+    int render_threads;
+    int render_queue_depth;
+    bool render_labeled_only;
+
+    bool batch_job;
+    Semaphore *decode_limit;
+    Semaphore *write_limit;
+
+    int prefetch_depth;
+    int prefetch_threads;
+    int writer_queue_depth;
+    int writer_threads;
+    int label_flush_ms;
+    int frame_cache_mb;
+
+    bool profile;
+    std::filesystem::path trace_path;
+
+protected:
+    std::filesystem::path out_dir;
     std::vector<std::string> names;
     std::vector<std::vector<int>> colors;
+
+    OutputManifest outputs; // Frames and label files of `out_dir`, outlives `annotations` which writes to it
+    AnnotationStore annotations;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include <iostream>
+#include <iomanip>
+
+#include "StageProfiler.h"
+
+using namespace std;
+
+static const char *STAGE_NAMES[STAGE_COUNT] = {
+    "decode",
+    "imwrite",
+    "resize",
+    "label_load",
+    "tracker_update",
+    "label_write",
+    "label_flush",
+    "propose",
+    "display",
+    "encode",
+    "frame",
+};
+
+StageProfiler &StageProfiler::instance()
+{
+    static StageProfiler profiler;
+    return profiler;
+}
+
+StageProfiler::StageProfiler() : histograms(STAGE_COUNT)
+{
+    this->enabled = false;
+    this->tracing = false;
+    this->first_event = true;
+    this->origin = chrono::steady_clock::now();
+
+    for (Histogram &histogram : this->histograms)
+    {
+        for (auto &bucket : histogram.buckets)
+            bucket = 0;
+        histogram.count = 0;
+        histogram.total_us = 0;
+        histogram.max_us = 0;
+    }
+}
+
+StageProfiler::~StageProfiler()
+{
+    this->close();
+}
+
+void StageProfiler::open(bool enable, filesystem::path trace_path)
+{
+    /*
+    Histograms cost a few atomic adds per stage, so they can stay on.
+    With a `trace_path` every stage is also written as a Chrome trace event (chrome://tracing, Perfetto).
+    */
+
+    this->enabled = enable;
+    if (!enable || trace_path.empty())
+        return;
+
+    lock_guard<mutex> lock(this->trace_mtx);
+    this->trace.open(trace_path);
+    if (!this->trace.is_open())
+    {
+        cout << "Fail to open: " << trace_path << endl;
+        exit(1);
+    }
+    this->trace << "{\"traceEvents\":[\n";
+    this->first_event = true;
+    this->tracing = true;
+
+    return;
+}
+
+void StageProfiler::close()
+{
+    lock_guard<mutex> lock(this->trace_mtx);
+    this->tracing = false;
+    if (this->trace.is_open())
+    {
+        this->trace << "\n]}\n";
+        this->trace.close();
+    }
+
+    return;
+}
+
+bool StageProfiler::is_enabled()
+{
+    return this->enabled;
+}
+
+void StageProfiler::record(Stage stage, int frame_id, chrono::steady_clock::time_point begin, chrono::steady_clock::time_point end)
+{
+    uint64_t us = chrono::duration_cast<chrono::microseconds>(end - begin).count();
+
+    Histogram &histogram = this->histograms[stage];
+    histogram.buckets[this->bucket_index(us)].fetch_add(1, memory_order_relaxed);
+    histogram.count.fetch_add(1, memory_order_relaxed);
+    histogram.total_us.fetch_add(us, memory_order_relaxed);
+
+    uint64_t max_us = histogram.max_us.load(memory_order_relaxed);
+    while (us > max_us && !histogram.max_us.compare_exchange_weak(max_us, us, memory_order_relaxed))
+    {
+    }
+
+    if (!this->tracing)
+        return;
+
+    uint64_t ts = chrono::duration_cast<chrono::microseconds>(begin - this->origin).count();
+
+    lock_guard<mutex> lock(this->trace_mtx);
+    if (!this->trace.is_open())
+        return;
+
+    this->trace << (this->first_event ? "" : ",\n")
+                << "{\"name\":\"" << STAGE_NAMES[stage] << "\",\"ph\":\"X\",\"pid\":1"
+                << ",\"tid\":" << this->thread_index()
+                << ",\"ts\":" << ts << ",\"dur\":" << us;
+    if (frame_id >= 0)
+        this->trace << ",\"args\":{\"frame\":" << frame_id << "}";
+    this->trace << "}";
+    this->first_event = false;
+
+    return;
+}
+
+void StageProfiler::dump()
+{
+    if (!this->enabled)
+        return;
+
+    cout << "==================================================" << endl
+         << left << setw(16) << "Stage" << right
+         << setw(10) << "count" << setw(12) << "mean(us)" << setw(12) << "p50(us)"
+         << setw(12) << "p99(us)" << setw(12) << "max(us)" << endl;
+
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        Histogram &histogram = this->histograms[i];
+        uint64_t count = histogram.count;
+        if (count == 0)
+            continue;
+
+        cout << left << setw(16) << STAGE_NAMES[i] << right
+             << setw(10) << count
+             << setw(12) << histogram.total_us / count
+             << setw(12) << this->percentile((Stage)i, 0.5)
+             << setw(12) << this->percentile((Stage)i, 0.99)
+             << setw(12) << histogram.max_us << endl;
+    }
+
+    return;
+}
+
+int StageProfiler::bucket_index(uint64_t us)
+{
+    if (us < SUB_BUCKETS)
+        return us;
+
+    int exponent = 63 - __builtin_clzll(us); // >= 3
+    int sub = (us >> (exponent - 3)) & (SUB_BUCKETS - 1);
+    int idx = SUB_BUCKETS + (exponent - 3) * SUB_BUCKETS + sub;
+
+    return min(idx, BUCKETS - 1);
+}
+
+uint64_t StageProfiler::bucket_value(int idx)
+{
+    /*
+    Lower bound of the bucket.
+    */
+
+    if (idx < SUB_BUCKETS)
+        return idx;
+
+    int exponent = (idx - SUB_BUCKETS) / SUB_BUCKETS + 3;
+    int sub = (idx - SUB_BUCKETS) % SUB_BUCKETS;
+
+    return (uint64_t)(SUB_BUCKETS + sub) << (exponent - 3);
+}
+
+uint64_t StageProfiler::percentile(Stage stage, double q)
+{
+    Histogram &histogram = this->histograms[stage];
+    uint64_t target = (uint64_t)(q * histogram.count);
+    uint64_t seen = 0;
+
+    for (int i = 0; i < BUCKETS; ++i)
+    {
+        seen += histogram.buckets[i];
+        if (seen > target)
+            return this->bucket_value(i);
+    }
+
+    return histogram.max_us;
+}
+
+int StageProfiler::thread_index()
+{
+    /*
+    Small stable id per thread for the trace viewer. Caller holds `trace_mtx`.
+    */
+
+    auto it = this->thread_ids.find(this_thread::get_id());
+    if (it != this->thread_ids.end())
+        return it->second;
+
+    int idx = this->thread_ids.size() + 1;
+    this->thread_ids[this_thread::get_id()] = idx;
+
+    return idx;
+}
+
+ScopedStage::ScopedStage(Stage stage, int frame_id)
+{
+    this->stage = stage;
+    this->frame_id = frame_id;
+    this->enabled = StageProfiler::instance().is_enabled();
+
+    if (this->enabled)
+        this->begin = chrono::steady_clock::now();
+}
+
+ScopedStage::~ScopedStage()
+{
+    this->stop();
+}
+
+void ScopedStage::stop()
+{
+    /*
+    End the stage before the end of the scope, e.g. before waiting for the user.
+    */
+
+    if (this->enabled)
+        StageProfiler::instance().record(this->stage, this->frame_id, this->begin, chrono::steady_clock::now());
+    this->enabled = false;
+}
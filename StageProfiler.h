@@ -0,0 +1,93 @@
+#ifndef __StageProfiler__H
+#define __StageProfiler__H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+#include <thread>
+#include <filesystem>
+
+enum Stage
+{
+    STAGE_DECODE,
+    STAGE_IMWRITE,
+    STAGE_RESIZE,
+    STAGE_LABEL_LOAD,
+    STAGE_TRACKER_UPDATE,
+    STAGE_LABEL_WRITE,
+    STAGE_LABEL_FLUSH,
+    STAGE_PROPOSE,
+    STAGE_DISPLAY,
+    STAGE_ENCODE,
+    STAGE_FRAME,
+    STAGE_COUNT
+};
+
+class StageProfiler
+{
+public:
+    static StageProfiler &instance();
+
+    void open(bool enable, std::filesystem::path trace_path);
+    void close();
+    bool is_enabled();
+
+    void record(Stage stage, int frame_id, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+    void dump();
+
+private:
+    StageProfiler();
+    ~StageProfiler();
+
+    static int bucket_index(uint64_t us);
+    static uint64_t bucket_value(int idx);
+    uint64_t percentile(Stage stage, double q);
+    int thread_index();
+
+private:
+    /*
+    Log-linear latency histogram in microseconds:
+    8 linear sub-buckets per power of two, about 12% relative error up to ~10^12 us.
+    */
+    static const int SUB_BUCKETS = 8;
+    static const int BUCKETS = SUB_BUCKETS + 40 * SUB_BUCKETS;
+
+    struct Histogram
+    {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total_us;
+        std::atomic<uint64_t> max_us;
+    };
+
+    std::atomic<bool> enabled;
+    std::vector<Histogram> histograms;
+    std::chrono::steady_clock::time_point origin;
+
+    std::ofstream trace;
+    std::atomic<bool> tracing;
+    bool first_event;
+    std::unordered_map<std::thread::id, int> thread_ids;
+    std::mutex trace_mtx;
+};
+
+class ScopedStage
+{
+public:
+    ScopedStage(Stage stage, int frame_id);
+    ~ScopedStage();
+
+    void stop();
+
+private:
+    Stage stage;
+    int frame_id;
+    bool enabled;
+    std::chrono::steady_clock::time_point begin;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int num_threads)
+{
+    /*
+    `num_threads <= 0` means one worker per hardware thread.
+    */
+
+    if (num_threads <= 0)
+        num_threads = max((int)thread::hardware_concurrency(), 1);
+
+    this->stopping = false;
+    for (int i = 0; i < num_threads; ++i)
+        this->workers.emplace_back(&ThreadPool::worker_loop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->stopping = true;
+    }
+    this->cv.notify_all();
+
+    for (auto &worker : this->workers)
+        worker.join();
+}
+
+future<void> ThreadPool::submit(function<void()> task)
+{
+    packaged_task<void()> job(task);
+    future<void> result = job.get_future();
+    {
+        lock_guard<mutex> lock(this->mtx);
+        this->tasks.push(move(job));
+    }
+    this->cv.notify_one();
+
+    return result;
+}
+
+void ThreadPool::parallel_for(int n, function<void(int)> fn)
+{
+    /*
+    Run `fn(0) ... fn(n - 1)` on the workers and block until all of them are done.
+    Indices are split into one contiguous chunk per worker.
+    */
+
+    if (n <= 0)
+        return;
+
+    int chunks = min(n, this->size());
+    int step = (n + chunks - 1) / chunks;
+
+    vector<future<void>> results;
+    for (int begin = 0; begin < n; begin += step)
+    {
+        int end = min(begin + step, n);
+        results.push_back(this->submit([begin, end, &fn]()
+                                       {
+                                           for (int i = begin; i < end; ++i)
+                                               fn(i);
+                                       }));
+    }
+
+    for (auto &result : results)
+        result.get();
+
+    return;
+}
+
+int ThreadPool::size()
+{
+    return this->workers.size();
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true)
+    {
+        packaged_task<void()> job;
+        {
+            unique_lock<mutex> lock(this->mtx);
+            this->cv.wait(lock, [this]()
+                          { return this->stopping || !this->tasks.empty(); });
+
+            if (this->stopping && this->tasks.empty())
+                return;
+
+            job = move(this->tasks.front());
+            this->tasks.pop();
+        }
+        job();
+    }
+}
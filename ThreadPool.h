@@ -0,0 +1,34 @@
+#ifndef __ThreadPool__H
+#define __ThreadPool__H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+class ThreadPool
+{
+public:
+    ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    std::future<void> submit(std::function<void()> task);
+    void parallel_for(int n, std::function<void(int)> fn);
+    int size();
+
+private:
+    void worker_loop();
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> tasks;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping;
+};
+
+#endif
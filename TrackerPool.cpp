@@ -0,0 +1,265 @@
+#include <opencv2/tracking/tracking_legacy.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+
+#include "TrackerPool.h"
+
+using namespace cv;
+using namespace std;
+
+// "auto" starts with the most accurate backend and steps down while the budget is missed
+static const vector<string> AUTO_BACKENDS = {"CSRT", "KCF", "MOSSE"};
+static const int AUTO_WARMUP_UPDATES = 5;
+
+TrackerPool::TrackerPool(int num_threads, TrackerOptions options) : workers(num_threads)
+{
+    this->next_id = 0;
+    this->options = options;
+
+    // Fail on a wrong backend name now, not on the first 'a'
+    if (this->options.backend != "auto")
+        this->create_tracker(this->options.backend);
+}
+
+TrackerPool::~TrackerPool()
+{
+}
+
+Ptr<Tracker> TrackerPool::create_tracker(string backend)
+{
+    if (backend == "CSRT")
+        return TrackerCSRT::create();
+    if (backend == "KCF")
+        return TrackerKCF::create();
+    if (backend == "MIL")
+        return TrackerMIL::create();
+    if (backend == "MOSSE")
+        return legacy::upgradeTrackingAPI(legacy::TrackerMOSSE::create());
+
+    throw runtime_error("`backend` invalid: " + backend + "\nSupport: \"CSRT\", \"KCF\", \"MOSSE\", \"MIL\", \"auto\"");
+}
+
+int TrackerPool::add(Mat frame, Rect2i area, string class_name, bool remove_item, int action)
+{
+    /*
+    Start a new track on `frame`, returns the id of the track or -1 for an empty box.
+    */
+
+    area = area & Rect2i(0, 0, frame.cols, frame.rows);
+    if (area.area() <= 0)
+    {
+        cout << "Empty box, skip" << endl;
+        return -1;
+    }
+
+    Track track;
+    track.id = this->next_id++;
+    track.class_name = class_name;
+    track.remove_item = remove_item;
+    track.action = action;
+    track.success = false;
+    track.lost = 0;
+
+    track.auto_level = 0;
+    track.backend = (this->options.backend == "auto") ? AUTO_BACKENDS[0] : this->options.backend;
+
+    this->init_track(track, frame, area);
+    this->tracks.push_back(track);
+
+    return track.id;
+}
+
+void TrackerPool::remove(int track_id)
+{
+    auto it = remove_if(this->tracks.begin(), this->tracks.end(), [track_id](Track &track)
+                        { return track.id == track_id; });
+    this->tracks.erase(it, this->tracks.end());
+
+    return;
+}
+
+void TrackerPool::clear()
+{
+    this->tracks.clear();
+    return;
+}
+
+void TrackerPool::update(Mat frame)
+{
+    /*
+    Update every active track on `frame`, one track per worker task.
+    Each task only touches its own `Track`, the frame is shared read-only.
+    */
+
+    this->workers.parallel_for(this->tracks.size(), [this, &frame](int i)
+                               { this->update_track(this->tracks[i], frame); });
+    return;
+}
+
+void TrackerPool::remove_lost(int max_lost)
+{
+    /*
+    Drop tracks that failed more than `max_lost` updates in a row.
+    */
+
+    auto it = remove_if(this->tracks.begin(), this->tracks.end(), [max_lost](Track &track)
+                        { return track.lost > max_lost; });
+    this->tracks.erase(it, this->tracks.end());
+
+    return;
+}
+
+int TrackerPool::rewind(Mat frame, int frame_id)
+{
+    /*
+    Restart every track on `frame` (an earlier or later frame than the last update)
+    from the box it saved there. Tracks that saved no box on `frame_id` are dropped.
+    Returns the number of tracks dropped.
+    */
+
+    Rect2i frame_rect(0, 0, frame.cols, frame.rows);
+    int dropped = 0;
+
+    vector<Track> kept;
+    for (Track &track : this->tracks)
+    {
+        auto written = track.written.find(frame_id);
+        if (written == track.written.end() || (written->second & frame_rect).area() <= 0)
+        {
+            ++dropped;
+            continue;
+        }
+
+        this->init_track(track, frame, written->second & frame_rect);
+        track.box = written->second;
+        track.success = false;
+        track.lost = 0;
+        kept.push_back(track);
+    }
+    this->tracks = kept;
+
+    return dropped;
+}
+
+vector<Track> &TrackerPool::get_tracks()
+{
+    return this->tracks;
+}
+
+bool TrackerPool::empty()
+{
+    return this->tracks.empty();
+}
+
+void TrackerPool::init_track(Track &track, Mat frame, Rect2i box)
+{
+    /*
+    (Re)start the tracker of `track` on a search window centered on `box`.
+    The window is downscaled so its longest side is at most `max_window_size`.
+    */
+
+    Rect2i frame_rect(0, 0, frame.cols, frame.rows);
+
+    if (this->options.search_window <= 0)
+        track.window = frame_rect;
+    else
+    {
+        int window_w = max((int)(box.width * this->options.search_window), 32);
+        int window_h = max((int)(box.height * this->options.search_window), 32);
+        int cx = box.x + box.width / 2;
+        int cy = box.y + box.height / 2;
+        track.window = Rect2i(cx - window_w / 2, cy - window_h / 2, window_w, window_h) & frame_rect;
+    }
+
+    int long_side = max(track.window.width, track.window.height);
+    track.scale = (this->options.max_window_size > 0 && long_side > this->options.max_window_size) ? (double)this->options.max_window_size / long_side : 1.0;
+
+    Rect2i local((int)((box.x - track.window.x) * track.scale), (int)((box.y - track.window.y) * track.scale),
+                 max((int)(box.width * track.scale), 1), max((int)(box.height * track.scale), 1));
+
+    track.tracker = this->create_tracker(track.backend);
+    track.tracker->init(this->crop(track, frame), local);
+    track.box = box;
+
+    track.latency_ms = 0;
+    track.updates = 0;
+
+    return;
+}
+
+void TrackerPool::update_track(Track &track, Mat frame)
+{
+    auto begin = chrono::steady_clock::now();
+
+    Rect2i local;
+    track.success = track.tracker->update(this->crop(track, frame), local);
+    track.lost = track.success ? 0 : track.lost + 1;
+
+    float latency_ms = chrono::duration<float, milli>(chrono::steady_clock::now() - begin).count();
+    track.latency_ms = (track.updates == 0) ? latency_ms : 0.8f * track.latency_ms + 0.2f * latency_ms;
+    ++track.updates;
+
+    if (!track.success)
+        return;
+
+    track.box = Rect2i((int)(local.x / track.scale) + track.window.x, (int)(local.y / track.scale) + track.window.y,
+                       (int)(local.width / track.scale), (int)(local.height / track.scale));
+
+    Rect2i frame_rect(0, 0, frame.cols, frame.rows);
+    Rect2i box = track.box & frame_rect;
+    if (box.area() <= 0)
+        return;
+
+    // "auto": the track misses its budget, move to the next cheaper backend
+    if (this->options.backend == "auto" && track.updates > AUTO_WARMUP_UPDATES &&
+        track.latency_ms > this->options.latency_budget_ms && track.auto_level + 1 < (int)AUTO_BACKENDS.size())
+    {
+        track.backend = AUTO_BACKENDS[++track.auto_level];
+        this->init_track(track, frame, box);
+    }
+
+    // The tracker cannot see past the window border: restart it on a window centered on the box,
+    // only once the box reaches the border, a new model is costly and starts from the tracked box
+    else if (this->touches_window_edge(track, frame_rect))
+        this->init_track(track, frame, box);
+
+    return;
+}
+
+Mat TrackerPool::crop(Track &track, Mat frame)
+{
+    Mat roi = frame(track.window);
+    if (track.scale == 1.0)
+        return roi;
+
+    Mat resized;
+    resize(roi, resized, Size(), track.scale, track.scale, INTER_AREA);
+    return resized;
+}
+
+bool TrackerPool::touches_window_edge(Track &track, Rect2i frame_rect)
+{
+    /*
+    True when the box reaches a window side that can still move (a side on the frame border cannot).
+    */
+
+    if (this->options.search_window <= 0)
+        return false;
+
+    Rect2i &box = track.box;
+    Rect2i &window = track.window;
+
+    if (window.x > frame_rect.x && box.x <= window.x)
+        return true;
+    if (window.y > frame_rect.y && box.y <= window.y)
+        return true;
+    if (window.x + window.width < frame_rect.width && box.x + box.width >= window.x + window.width)
+        return true;
+    if (window.y + window.height < frame_rect.height && box.y + box.height >= window.y + window.height)
+        return true;
+
+    return false;
+}
@@ -0,0 +1,74 @@
+#ifndef __TrackerPool__H
+#define __TrackerPool__H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/tracking.hpp>
+
+#include "ThreadPool.h"
+
+struct TrackerOptions
+{
+    std::string backend;     // "CSRT", "KCF", "MOSSE", "MIL" or "auto"
+    float search_window;     // Window size as a multiple of the box size, <= 0 means the full frame
+    int max_window_size;     // Longest window side fed to the tracker, <= 0 means no downscale
+    float latency_budget_ms; // Per-track update budget used by "auto"
+};
+
+struct Track
+{
+    int id;
+    std::string class_name;
+    bool remove_item;
+    int action; // Undo action its boxes are recorded in, -1 for none
+    std::map<int, cv::Rect2i> written; // Box saved on each frame, frame coordinates
+
+    cv::Ptr<cv::Tracker> tracker;
+    cv::Rect2i box; // Frame coordinates
+    bool success;
+    int lost; // Consecutive failed updates
+
+    std::string backend;
+    int auto_level;    // Index in the "auto" backend list
+    cv::Rect2i window; // Search window in frame coordinates
+    double scale;      // Window to tracker input scale
+    float latency_ms;  // Moving average of the update time
+    int updates;
+};
+
+class TrackerPool
+{
+public:
+    TrackerPool(int num_threads, TrackerOptions options);
+    ~TrackerPool();
+
+    int add(cv::Mat frame, cv::Rect2i area, std::string class_name, bool remove_item, int action = -1);
+    void remove(int track_id);
+    void clear();
+    void update(cv::Mat frame);
+    void remove_lost(int max_lost);
+    int rewind(cv::Mat frame, int frame_id);
+
+    std::vector<Track> &get_tracks();
+    bool empty();
+
+    static cv::Ptr<cv::Tracker> create_tracker(std::string backend);
+
+private:
+    void init_track(Track &track, cv::Mat frame, cv::Rect2i box);
+    void update_track(Track &track, cv::Mat frame);
+    cv::Mat crop(Track &track, cv::Mat frame);
+    bool touches_window_edge(Track &track, cv::Rect2i frame_rect);
+
+private:
+    std::vector<Track> tracks;
+    int next_id;
+
+    TrackerOptions options;
+    ThreadPool workers;
+};
+
+#endif
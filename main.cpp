@@ -0,0 +1,79 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <exception>
+
+#include "SemiAutomaticLabelingTool.h"
+#include "BatchRunner.h"
+#include "DatasetExporter.h"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    /*
+    Usage: SemiAutomaticLabelingTool [mode]
+
+    mode:
+        label      --> Interactive labeling (default)
+        export_txt --> Export `labels.pack` to per-frame YOLO txt files
+        export     --> Every frame and label under `OUTPUT_DIR` to COCO JSON / Pascal VOC,
+                       see `EXPORT` in the config file [output_dir]
+        extract    --> Save the frames of `video_path`, see `EXTRACT` in the config file
+        propagate  --> Headless tracking of seed boxes, see `PROPAGATE` in the config file
+                       [--seed class_name,cx,cy,w,h ...]
+        interpolate --> Headless, boxes on sparse keyframes and interpolated in between,
+                        see `INTERPOLATE` in the config file [--seed class_name,cx,cy,w,h ...]
+        render      --> Headless review video of the labels, see `RENDER` in the config file
+        batch       --> Headless `BATCH: task` on many videos at once [video or glob ...]
+    */
+
+    string mode = (argc > 1) ? argv[1] : "label";
+    vector<string> args(argv + min(argc, 2), argv + argc);
+
+    // Label store, journal and pack errors are thrown, a run stops on the first one
+    try
+    {
+        if (mode == "batch")
+        {
+            BatchRunner batch("./config_LabelTool.yaml");
+            batch.run(args);
+            return 0;
+        }
+
+        if (mode == "export")
+        {
+            DatasetExporter exporter("./config_LabelTool.yaml");
+            exporter.run(args);
+            return 0;
+        }
+
+        SemiAutomaticLabel tool;
+        if (mode == "label")
+            tool.start();
+        else if (mode == "export_txt")
+            tool.export_txt();
+        else if (mode == "extract")
+            tool.extract_frames();
+        else if (mode == "propagate")
+            tool.propagate(args);
+        else if (mode == "interpolate")
+            tool.interpolate(args);
+        else if (mode == "render")
+            tool.render_video();
+        else
+        {
+            cout << "Unknown mode: " << mode << endl
+                 << "Support: label, export_txt, export, extract, propagate, interpolate, render, batch" << endl;
+            return 1;
+        }
+    }
+    catch (const exception &e)
+    {
+        cout << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "BoxGeometry.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+static vector<Box> random_boxes(int n, int width, int height, unsigned seed)
+{
+    mt19937 rng(seed);
+    uniform_int_distribution<int> x(0, width - 1), y(0, height - 1), size(1, 120);
+
+    vector<Box> boxes;
+    for (int i = 0; i < n; ++i)
+    {
+        int xmin = x(rng), ymin = y(rng);
+        boxes.push_back({xmin, ymin, min(xmin + size(rng), width - 1), min(ymin + size(rng), height - 1)});
+    }
+
+    return boxes;
+}
+
+static void test_box_iou()
+{
+    Box a({0, 0, 10, 10});
+
+    CHECK(box_area(a) == 100);
+    CHECK_NEAR(box_iou(a, a), 1.0f, 1e-6f);
+    CHECK_NEAR(box_iou(a, Box({20, 20, 30, 30})), 0.0f, 1e-6f);
+    CHECK_NEAR(box_iou(a, Box({10, 0, 20, 10})), 0.0f, 1e-6f); // Touching edges
+    CHECK_NEAR(box_iou(a, Box({5, 0, 15, 10})), 50.0f / 150, 1e-6f);
+    CHECK_NEAR(box_iou(a, Box({0, 0, 5, 5})), 25.0f / 100, 1e-6f);
+
+    Box clipped = box_clip(Box({-5, -5, 700, 500}), 640, 480);
+    CHECK(clipped.xmin == 0 && clipped.ymin == 0 && clipped.xmax == 639 && clipped.ymax == 479);
+}
+
+static void test_batch_matches_scalar()
+{
+    /*
+    The SIMD kernel against `box_iou`, with a count that is not a multiple of 4 so the tail is covered.
+    */
+
+    vector<Box> boxes = random_boxes(103, 640, 480, 1);
+    BoxBatch batch;
+    for (const Box &box : boxes)
+        batch.push_back(box);
+    CHECK(batch.size() == (int)boxes.size());
+
+    vector<float> iou(batch.size()), overlap(batch.size());
+    for (const Box &query : random_boxes(20, 640, 480, 2))
+    {
+        batch.iou(query, iou.data());
+        batch.overlap(query, overlap.data());
+        for (size_t i = 0; i < boxes.size(); ++i)
+        {
+            CHECK_NEAR(iou[i], box_iou(query, boxes[i]), 1e-5f);
+            CHECK_NEAR(overlap[i], (float)box_overlap(query, boxes[i]), 1e-3f);
+        }
+    }
+
+    batch.clear();
+    CHECK(batch.size() == 0);
+}
+
+static void test_grid_query()
+{
+    /*
+    Every box overlapping the query is reported, each one once.
+    */
+
+    vector<Box> boxes = random_boxes(200, 640, 480, 3);
+    BoxBatch batch;
+    for (const Box &box : boxes)
+        batch.push_back(box);
+
+    BoxGrid grid(640, 480, 64);
+    grid.build(batch);
+
+    vector<int> ids;
+    vector<Box> queries = random_boxes(50, 640, 480, 4);
+    queries.push_back({-50, -50, 1000, 1000}); // Past the frame on every side
+    for (const Box &query : queries)
+    {
+        grid.query(query, ids);
+
+        vector<int> sorted = ids;
+        sort(sorted.begin(), sorted.end());
+        CHECK(adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+
+        for (size_t i = 0; i < boxes.size(); ++i)
+            if (box_overlap(query, boxes[i]) > 0)
+                CHECK(binary_search(sorted.begin(), sorted.end(), (int)i));
+    }
+}
+
+int main()
+{
+    test_box_iou();
+    test_batch_matches_scalar();
+    test_grid_query();
+
+    return test_result();
+}
@@ -0,0 +1,149 @@
+#include <fstream>
+#include <filesystem>
+#include <unistd.h>
+
+#include "EditJournal.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+static LabelEdit make_edit(int frame_id, int before, int after)
+{
+    LabelEdit edit;
+    edit.frame_id = frame_id;
+    for (int i = 0; i < before; ++i)
+        edit.before.push_back({i, 0.1f * i, 0.2f, 0.3f, 0.4f});
+    for (int i = 0; i < after; ++i)
+        edit.after.push_back({i, 0.5f, 0.1f * i, 0.3f, 0.4f});
+
+    return edit;
+}
+
+static bool same_labels(const vector<Label> &a, const vector<Label> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i].class_id != b[i].class_id || a[i].cx != b[i].cx || a[i].cy != b[i].cy || a[i].w != b[i].w || a[i].h != b[i].h)
+            return false;
+
+    return true;
+}
+
+static bool same_edit(const LabelEdit &a, const LabelEdit &b)
+{
+    return a.frame_id == b.frame_id && same_labels(a.before, b.before) && same_labels(a.after, b.after);
+}
+
+static void test_replay(filesystem::path journal_path)
+{
+    vector<LabelEdit> written = {make_edit(3, 0, 2), make_edit(3, 2, 1), make_edit(10, 1, 0), make_edit(0, 0, 0)};
+    {
+        EditJournal journal;
+        CHECK(journal.open(journal_path).empty());
+        CHECK(journal.is_open());
+        for (const LabelEdit &edit : written)
+            journal.append(edit);
+    }
+
+    vector<LabelEdit> edits = EditJournal::read(journal_path);
+    CHECK(edits.size() == written.size());
+    for (size_t i = 0; i < edits.size() && i < written.size(); ++i)
+        CHECK(same_edit(edits[i], written[i]));
+
+    // Appending after a reopen goes behind the replayed records
+    EditJournal journal;
+    CHECK(journal.open(journal_path).size() == written.size());
+    journal.append(make_edit(4, 1, 1));
+    CHECK(EditJournal::read(journal_path).size() == written.size() + 1);
+}
+
+static void test_torn_record(filesystem::path journal_path)
+{
+    int64_t valid;
+    {
+        EditJournal journal;
+        journal.open(journal_path);
+        journal.append(make_edit(1, 0, 1));
+        journal.append(make_edit(2, 1, 2));
+        valid = journal.size();
+    }
+
+    // A crash in the middle of the third append
+    {
+        EditJournal journal;
+        journal.open(journal_path);
+        journal.append(make_edit(3, 2, 3));
+    }
+    filesystem::resize_file(journal_path, filesystem::file_size(journal_path) - 7);
+
+    CHECK(EditJournal::read(journal_path).size() == 2);
+    CHECK((int64_t)filesystem::file_size(journal_path) > valid); // `read` leaves the torn record in place
+
+    EditJournal journal;
+    vector<LabelEdit> edits = journal.open(journal_path);
+    CHECK(edits.size() == 2);
+    CHECK(journal.size() == valid);
+    CHECK((int64_t)filesystem::file_size(journal_path) == valid);
+}
+
+static void test_compaction(filesystem::path journal_path)
+{
+    EditJournal journal;
+    journal.open(journal_path);
+    journal.append(make_edit(1, 0, 1));
+    journal.append(make_edit(2, 0, 1));
+    int64_t offset = journal.size();
+    journal.append(make_edit(3, 1, 2));
+    journal.append(make_edit(4, 2, 0));
+
+    // Records before `offset` are in the label files, the later ones survive
+    journal.drop_before(offset);
+    vector<LabelEdit> edits = EditJournal::read(journal_path);
+    CHECK(edits.size() == 2);
+    CHECK(edits.size() == 2 && same_edit(edits[0], make_edit(3, 1, 2)) && same_edit(edits[1], make_edit(4, 2, 0)));
+
+    // The journal stays usable after the swap
+    journal.append(make_edit(5, 0, 1));
+    CHECK(EditJournal::read(journal_path).size() == 3);
+
+    journal.drop_before(journal.size());
+    CHECK(EditJournal::read(journal_path).empty());
+
+    journal.append(make_edit(6, 0, 1));
+    journal.truncate();
+    CHECK(EditJournal::read(journal_path).empty());
+    CHECK(journal.size() == (int64_t)sizeof(EditJournalHeader));
+}
+
+static void test_invalid(filesystem::path journal_path)
+{
+    CHECK(EditJournal::read(journal_path / "missing.journal").empty());
+
+    ofstream(journal_path, ios::binary | ios::trunc) << "not an edit journal";
+    bool thrown = false;
+    try
+    {
+        EditJournal::read(journal_path);
+    }
+    catch (const exception &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+int main()
+{
+    filesystem::path dir = filesystem::temp_directory_path() / ("EditJournalTest_" + to_string(getpid()));
+    filesystem::create_directories(dir);
+
+    test_replay(dir / "replay.journal");
+    test_torn_record(dir / "torn.journal");
+    test_compaction(dir / "compaction.journal");
+    test_invalid(dir / "invalid.journal");
+
+    filesystem::remove_all(dir);
+
+    return test_result();
+}
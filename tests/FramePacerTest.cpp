@@ -0,0 +1,98 @@
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "FramePacer.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+static void test_speed()
+{
+    FramePacer pacer(25);
+    CHECK_NEAR(pacer.target_fps(), 25.0, 1e-9);
+
+    pacer.set_speed(2);
+    CHECK_NEAR(pacer.speed(), 2.0, 1e-9);
+    CHECK_NEAR(pacer.target_fps(), 50.0, 1e-9);
+
+    // Clamped to [1/8, 8]
+    pacer.set_speed(100);
+    CHECK_NEAR(pacer.speed(), 8.0, 1e-9);
+    pacer.set_speed(0);
+    CHECK_NEAR(pacer.speed(), 1.0 / 8, 1e-9);
+
+    // No frame rate from the video falls back to 30
+    FramePacer unknown(0);
+    CHECK_NEAR(unknown.target_fps(), 30.0, 1e-9);
+}
+
+static void test_on_time()
+{
+    /*
+    A fast loop is shown every frame and waits out the rest of the interval.
+    */
+
+    FramePacer pacer(20); // 50 ms per frame
+    for (int i = 0; i < 3; ++i)
+    {
+        pacer.begin_frame();
+        CHECK(pacer.should_display());
+
+        int wait = pacer.end_frame(true);
+        CHECK(wait >= 1 && wait <= 50);
+        this_thread::sleep_for(chrono::milliseconds(wait));
+    }
+
+    CHECK(pacer.dropped() == 0);
+    CHECK(pacer.processing_ms() >= 0);
+    CHECK(pacer.achieved_fps() > 0);
+}
+
+static void test_drop_when_late()
+{
+    /*
+    A loop slower than the frame rate drops frames, but never more than a few in a row.
+    */
+
+    FramePacer pacer(1000); // 1 ms per frame
+    int shown = 0, dropped_in_row = 0, longest_drop = 0;
+    for (int i = 0; i < 40; ++i)
+    {
+        pacer.begin_frame();
+        this_thread::sleep_for(chrono::milliseconds(3));
+
+        bool display = pacer.should_display();
+        int wait = pacer.end_frame(display);
+        if (display)
+        {
+            CHECK(wait >= 1);
+            ++shown;
+            dropped_in_row = 0;
+        }
+        else
+        {
+            CHECK(wait == 0);
+            ++dropped_in_row;
+            longest_drop = max(longest_drop, dropped_in_row);
+        }
+    }
+
+    CHECK(pacer.dropped() > 0);
+    CHECK(longest_drop <= 8);
+    CHECK(shown > 0);
+
+    // A reset owes nothing: the next frame is on time again
+    pacer.reset();
+    pacer.begin_frame();
+    CHECK(pacer.should_display());
+}
+
+int main()
+{
+    test_speed();
+    test_on_time();
+    test_drop_when_late();
+
+    return test_result();
+}
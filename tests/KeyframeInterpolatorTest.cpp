@@ -0,0 +1,111 @@
+#include <map>
+#include <vector>
+
+#include "KeyframeInterpolator.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+static void test_linear()
+{
+    KeyframeInterpolator interpolator("linear");
+    interpolator.add(0, 10, Label({1, 0.2f, 0.2f, 0.1f, 0.1f}));
+    interpolator.add(0, 14, Label({1, 0.6f, 0.4f, 0.3f, 0.1f}));
+    CHECK(interpolator.keyframe_count() == 2);
+
+    map<int, vector<Label>> frames;
+    interpolator.fill(frames, false);
+
+    // Only the frames strictly between the keyframes
+    CHECK(frames.size() == 3);
+    CHECK(frames.count(10) == 0 && frames.count(14) == 0);
+
+    const Label &mid = frames[12][0];
+    CHECK(mid.class_id == 1);
+    CHECK_NEAR(mid.cx, 0.4f, 1e-6f);
+    CHECK_NEAR(mid.cy, 0.3f, 1e-6f);
+    CHECK_NEAR(mid.w, 0.2f, 1e-6f);
+    CHECK_NEAR(mid.h, 0.1f, 1e-6f);
+    CHECK_NEAR(frames[11][0].cx, 0.3f, 1e-6f);
+
+    map<int, vector<Label>> with_keyframes;
+    interpolator.fill(with_keyframes, true);
+    CHECK(with_keyframes.size() == 5);
+    CHECK_NEAR(with_keyframes[14][0].cx, 0.6f, 1e-6f);
+}
+
+static void test_spline()
+{
+    /*
+    The curve goes through every keyframe, and keyframes on a straight line at constant speed give the linear boxes.
+    */
+
+    KeyframeInterpolator straight("spline");
+    for (int i = 0; i < 4; ++i)
+        straight.add(0, i * 10, Label({0, 0.1f + 0.2f * i, 0.5f, 0.2f, 0.2f}));
+
+    map<int, vector<Label>> frames;
+    straight.fill(frames, true);
+    CHECK(frames.size() == 31);
+    for (int frame_id = 0; frame_id <= 30; ++frame_id)
+        CHECK_NEAR(frames[frame_id][0].cx, 0.1f + 0.02f * frame_id, 1e-5f);
+
+    // A stop and go: the spline does not jump at the middle keyframe
+    KeyframeInterpolator curve("spline");
+    curve.add(0, 0, Label({0, 0.1f, 0.5f, 0.2f, 0.2f}));
+    curve.add(0, 10, Label({0, 0.5f, 0.5f, 0.2f, 0.2f}));
+    curve.add(0, 20, Label({0, 0.6f, 0.5f, 0.2f, 0.2f}));
+
+    frames.clear();
+    curve.fill(frames, true);
+    CHECK_NEAR(frames[10][0].cx, 0.5f, 1e-6f);
+    CHECK_NEAR(frames[9][0].cx, 0.5f, 0.05f);
+    CHECK_NEAR(frames[11][0].cx, 0.5f, 0.05f);
+    for (int frame_id = 1; frame_id <= 20; ++frame_id)
+        CHECK(frames[frame_id][0].cx >= frames[frame_id - 1][0].cx);
+}
+
+static void test_objects()
+{
+    /*
+    Objects are interpolated independently, a single keyframe adds no frame.
+    */
+
+    KeyframeInterpolator interpolator("spline");
+    interpolator.add(0, 0, Label({0, 0.1f, 0.1f, 0.05f, 0.05f}));
+    interpolator.add(0, 2, Label({0, 0.3f, 0.1f, 0.05f, 0.05f}));
+    interpolator.add(1, 1, Label({2, 0.9f, 0.9f, 0.05f, 0.05f}));
+    interpolator.add(2, 5, Label({3, 0.5f, 0.5f, 0.05f, 0.05f}));
+    interpolator.add(2, 7, Label({3, 0.5f, 0.5f, 0.0f, 0.0f}));
+
+    map<int, vector<Label>> frames;
+    interpolator.fill(frames, false);
+    CHECK(frames.size() == 2);
+    CHECK(frames[1].size() == 1 && frames[1][0].class_id == 0);
+    CHECK(frames[6].size() == 1 && frames[6][0].class_id == 3);
+    CHECK(frames[6].size() == 1 && frames[6][0].w >= 0 && frames[6][0].h >= 0);
+}
+
+static void test_unknown_method()
+{
+    bool thrown = false;
+    try
+    {
+        KeyframeInterpolator interpolator("cubic");
+    }
+    catch (const exception &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+int main()
+{
+    test_linear();
+    test_spline();
+    test_objects();
+    test_unknown_method();
+
+    return test_result();
+}
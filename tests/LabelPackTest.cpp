@@ -0,0 +1,136 @@
+#include <fstream>
+#include <string>
+#include <filesystem>
+#include <unistd.h>
+
+#include "LabelPack.h"
+#include "LabelParser.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+static bool same_label(const Label &a, const Label &b)
+{
+    return a.class_id == b.class_id && a.cx == b.cx && a.cy == b.cy && a.w == b.w && a.h == b.h;
+}
+
+static void test_round_trip(filesystem::path pack_path)
+{
+    unordered_map<int, vector<Label>> frames;
+    frames[0] = {{0, 0.1f, 0.2f, 0.3f, 0.4f}};
+    frames[2] = {{1, 0.5f, 0.5f, 0.2f, 0.2f}, {2, 0.7f, 0.3f, 0.1f, 0.05f}};
+    frames[5] = {};
+
+    LabelPack empty;
+    LabelPack::write(pack_path, empty, frames);
+
+    LabelPack pack;
+    CHECK(pack.open(pack_path));
+    CHECK(pack.is_open());
+    CHECK(pack.frame_count() == 6);
+    CHECK(pack.count(0) == 1);
+    CHECK(pack.count(1) == 0 && pack.get(1) == nullptr);
+    CHECK(pack.count(2) == 2);
+    CHECK(pack.count(5) == 0);
+    CHECK(pack.count(-1) == 0 && pack.count(6) == 0);
+
+    CHECK(same_label(pack.get(0)[0], frames[0][0]));
+    CHECK(same_label(pack.get(2)[0], frames[2][0]));
+    CHECK(same_label(pack.get(2)[1], frames[2][1]));
+}
+
+static void test_merge(filesystem::path pack_path)
+{
+    /*
+    Frames of the update replace the same frames of the base, the others are copied over.
+    */
+
+    unordered_map<int, vector<Label>> frames;
+    frames[1] = {{1, 0.1f, 0.1f, 0.1f, 0.1f}};
+    frames[3] = {{3, 0.3f, 0.3f, 0.3f, 0.3f}};
+
+    LabelPack empty;
+    LabelPack::write(pack_path, empty, frames);
+
+    unordered_map<int, vector<Label>> update;
+    update[1] = {};
+    update[3] = {{4, 0.4f, 0.4f, 0.4f, 0.4f}, {5, 0.5f, 0.5f, 0.5f, 0.5f}};
+    update[8] = {{8, 0.8f, 0.8f, 0.1f, 0.1f}};
+    {
+        LabelPack base;
+        CHECK(base.open(pack_path));
+        LabelPack::write(pack_path, base, update);
+    }
+    CHECK(!filesystem::exists(pack_path.string() + ".tmp"));
+
+    LabelPack pack;
+    CHECK(pack.open(pack_path));
+    CHECK(pack.frame_count() == 9);
+    CHECK(pack.count(1) == 0);
+    CHECK(pack.count(3) == 2 && same_label(pack.get(3)[1], update[3][1]));
+    CHECK(pack.count(8) == 1 && same_label(pack.get(8)[0], update[8][0]));
+
+    unordered_map<int, vector<Label>> keep;
+    keep[0] = {{0, 0.5f, 0.5f, 0.5f, 0.5f}};
+    {
+        LabelPack base;
+        base.open(pack_path);
+        LabelPack::write(pack_path, base, keep);
+    }
+    CHECK(pack.open(pack_path));
+    CHECK(pack.count(0) == 1);
+    CHECK(pack.count(3) == 2 && same_label(pack.get(3)[0], update[3][0]));
+}
+
+static void test_export_txt(filesystem::path pack_path, filesystem::path txt_dir)
+{
+    unordered_map<int, vector<Label>> frames;
+    frames[4] = {{2, 0.5f, 0.25f, 0.125f, 0.0625f}};
+
+    LabelPack empty;
+    LabelPack::write(pack_path, empty, frames);
+
+    LabelPack pack;
+    pack.open(pack_path);
+    filesystem::create_directories(txt_dir);
+    pack.export_txt(txt_dir);
+
+    string text;
+    CHECK(LabelParser::read_file(txt_dir / "000004.txt", text));
+    CHECK(text == "2 0.500000 0.250000 0.125000 0.062500\n");
+    CHECK(!filesystem::exists(txt_dir / "000000.txt"));
+}
+
+static void test_invalid(filesystem::path pack_path)
+{
+    LabelPack pack;
+    CHECK(!pack.open(pack_path.string() + ".missing"));
+
+    ofstream(pack_path, ios::binary | ios::trunc) << string(64, 'x');
+    bool thrown = false;
+    try
+    {
+        pack.open(pack_path);
+    }
+    catch (const exception &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(!pack.is_open());
+}
+
+int main()
+{
+    filesystem::path dir = filesystem::temp_directory_path() / ("LabelPackTest_" + to_string(getpid()));
+    filesystem::create_directories(dir);
+
+    test_round_trip(dir / "round_trip.lblpack");
+    test_merge(dir / "merge.lblpack");
+    test_export_txt(dir / "export.lblpack", dir / "txt");
+    test_invalid(dir / "invalid.lblpack");
+
+    filesystem::remove_all(dir);
+
+    return test_result();
+}
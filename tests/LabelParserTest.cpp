@@ -0,0 +1,97 @@
+#include <string>
+#include <string_view>
+
+#include "LabelParser.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+static void test_parse_line()
+{
+    string text = "3 0.5 0.25 0.1 0.2";
+    Label label;
+
+    CHECK(LabelParser::parse_line(text.data(), text.data() + text.size(), label));
+    CHECK(label.class_id == 3);
+    CHECK_NEAR(label.cx, 0.5f, 1e-6f);
+    CHECK_NEAR(label.cy, 0.25f, 1e-6f);
+    CHECK_NEAR(label.w, 0.1f, 1e-6f);
+    CHECK_NEAR(label.h, 0.2f, 1e-6f);
+}
+
+static void test_old_parser_compatibility()
+{
+    /*
+    Lines the old stream parser accepted: leading '+', a fractional class id, tabs, CRLF and trailing fields.
+    */
+
+    Label label;
+    for (string text : {"+1 0.5 0.5 0.1 0.1", "1.5 0.5 0.5 0.1 0.1", "1\t0.5\t0.5\t0.1\t0.1\r", "1 0.5 0.5 0.1 0.1 0.9"})
+    {
+        CHECK(LabelParser::parse_line(text.data(), text.data() + text.size(), label));
+        CHECK(label.class_id == 1);
+        CHECK_NEAR(label.h, 0.1f, 1e-6f);
+    }
+}
+
+static void test_malformed()
+{
+    Label label;
+    for (string text : {"1 0.5 0.5 0.1", "a 0.5 0.5 0.1 0.1", "1 0.5x 0.5 0.1 0.1", "1 0.5 0.5 0.1 -"})
+        CHECK(!LabelParser::parse_line(text.data(), text.data() + text.size(), label));
+}
+
+static void test_next()
+{
+    string text = "0 0.1 0.1 0.1 0.1\n\n  \nbad line\r\n2 0.2 0.2 0.2 0.2";
+    LabelParser parser(text);
+    Label label;
+
+    CHECK(parser.next(label) == PARSE_LABEL);
+    CHECK(label.class_id == 0);
+    CHECK(parser.line_number() == 1);
+
+    // Blank lines are skipped, the bad line keeps its number
+    CHECK(parser.next(label) == PARSE_MALFORMED);
+    CHECK(parser.line_number() == 4);
+    CHECK(parser.line() == string_view("bad line\r"));
+
+    CHECK(parser.next(label) == PARSE_LABEL);
+    CHECK(label.class_id == 2);
+    CHECK(parser.line_number() == 5);
+
+    CHECK(parser.next(label) == PARSE_END);
+    CHECK(parser.next(label) == PARSE_END);
+}
+
+static void test_format_round_trip()
+{
+    char line[LABEL_LINE_MAX];
+    Label label({7, 0.123456f, 0.5f, 1.0f, 0.0f});
+
+    char *end = LabelParser::format(line, label);
+    CHECK(string(line, end) == "7 0.123456 0.500000 1.000000 0.000000\n");
+
+    Label parsed;
+    CHECK(LabelParser::parse_line(line, end - 1, parsed));
+    CHECK(parsed.class_id == label.class_id);
+    CHECK_NEAR(parsed.cx, label.cx, 1e-6f);
+    CHECK_NEAR(parsed.cy, label.cy, 1e-6f);
+    CHECK_NEAR(parsed.w, label.w, 1e-6f);
+    CHECK_NEAR(parsed.h, label.h, 1e-6f);
+
+    // The widest values still fit in LABEL_LINE_MAX
+    end = LabelParser::format(line, Label({-2147483647, -3.4e38f, 3.4e38f, -3.4e38f, 3.4e38f}));
+    CHECK(end - line <= LABEL_LINE_MAX);
+}
+
+int main()
+{
+    test_parse_line();
+    test_old_parser_compatibility();
+    test_malformed();
+    test_next();
+    test_format_round_trip();
+
+    return test_result();
+}
@@ -0,0 +1,33 @@
+#ifndef __TestCheck__H
+#define __TestCheck__H
+
+#include <cmath>
+#include <iostream>
+
+/*
+Checks of the unit tests: a failed check prints its line and the test goes on,
+`main` returns `test_result()` so ctest sees every failure of a run at once.
+*/
+
+static int test_failures = 0;
+
+#define CHECK(condition)                                                                   \
+    do                                                                                     \
+    {                                                                                      \
+        if (!(condition))                                                                  \
+        {                                                                                  \
+            std::cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            ++test_failures;                                                               \
+        }                                                                                  \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) CHECK(std::fabs((a) - (b)) <= (tolerance))
+
+static inline int test_result()
+{
+    if (test_failures > 0)
+        std::cout << test_failures << " check(s) failed" << std::endl;
+    return test_failures > 0 ? 1 : 0;
+}
+
+#endif